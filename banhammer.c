@@ -3,14 +3,26 @@
 // using basic pseudocode given in instructions
 #include "set.h"
 #include "salts.h"
-#include "messages.h"
+#include "batch.h"
 #include "bf.h"
 #include "bst.h"
 #include "bv.h"
+#include "fuzzy.h"
+#include "freq.h"
 #include "ht.h"
+#include "loader.h"
+#include "mem.h"
 #include "node.h"
 #include "parser.h"
+#include "pf.h"
+#include "pipeline.h"
+#include "report.h"
+#include "scanner.h"
+#include "segment.h"
 #include "speck.h"
+#include "trie.h"
+#include "utf8.h"
+#include "verdict.h"
 
 #include <stdio.h>
 #include <math.h>
@@ -22,6 +34,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 // The message() function prints out information about how to properly use the file
 // Inputs: void
@@ -30,16 +44,38 @@
 void message(void) {
     fprintf(stderr, "SYNOPSIS\n"
                     "  A word filtering program for the GPRSC.\n"
-                    "  Filters out and reports bad words parsed from stdin.\n"
+                    "  Filters out and reports bad words parsed from stdin, or from\n"
+                    "  each file named (a directory means every file in it, and - reads\n"
+                    "  a list of files from stdin) with one report per file.\n"
                     "\n"
                     "USAGE\n"
-                    "  ./banhammer [-hs] [-t size] [-f size]\n"
+                    "  ./banhammer [-hsuzeacvdil] [-t size] [-f size] [-p rate] [-j threads] [-o format]\n"
+                    "             [-n numa] [-m map] [-k name=file ...] [-r seed] [-g name] [file ...]\n"
                     "\n"
                     "OPTIONS\n"
                     "  -h           Program usage and help.\n"
-                    "  -s           Print program statistics\n"
+                    "  -s           Print program statistics, and the hash seed they came from.\n"
                     "  -t size      Specify hash table size (default: 2^16).\n"
-                    "  -f size      Specify Bloom filter size (default: 2^20).\n");
+                    "  -f size      Specify Bloom filter size (default: 2^20).\n"
+                    "  -p rate      Grow the Bloom filter to keep this false positive rate.\n"
+                    "  -j threads   Threads used to load and to check files (default: cores).\n"
+                    "  -n numa      Place big arrays local, interleave or replicate.\n"
+                    "  -o format    Report as text, json or binary (default: text).\n"
+                    "  -u           Tokenize and case fold input as UTF-8.\n"
+                    "  -z           Reject words by length and bigram before hashing.\n"
+                    "  -e           Also match look-alike spellings and one-letter typos.\n"
+                    "  -c           Freeze the hash table into dense arrays after loading.\n"
+                    "  -a           Read, tokenize and match stdin on separate threads.\n"
+                    "  -d           Look words up in a trie walked while reading them.\n"
+                    "  -v           Only classify stdin, stop once decided, exit with the class.\n"
+                    "  -i           Also match inflected words (-s, -ed, -ing, -er) by stem.\n"
+                    "  -m map       Look-alikes for -e as from/to pairs (default: " FUZZY_MAP ").\n"
+                    "  -k name=file Also load file as the word list of category name.\n"
+                    "  -r seed      Seed the hash salts, to repeat a run (default: random, so\n"
+                    "               -s statistics differ between runs unless the seed -s\n"
+                    "               printed is given again).\n"
+                    "  -g name      Share the loaded dictionary with other processes as name.\n"
+                    "  -l           With -g, load the word lists and publish a new version.\n");
     return;
 }
 
@@ -58,16 +94,27 @@ char *lower(char *word) {
     return word;
 }
 
-typedef enum { VERBOSE, THOUGHTCRIME, RIGHTSPEAK } Banhammer;
-#define OPTIONS "hst:f:"
+#define OPTIONS "hsuzeacvdilt:f:p:j:o:n:m:k:r:g:"
 
 int main(int argc, char **argv) {
     // Declare default values and set
     Set chosen = empty_set();
-    Set punishment = empty_set();
     int option = 0;
     uint64_t table_size = pow(2, 16);
     uint64_t filter_size = pow(2, 20);
+    double fp_rate = 0;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t threads = cores > 0 ? (uint32_t) cores : 1;
+    ReportFormat format = REPORT_TEXT;
+    char *map = FUZZY_MAP;
+    // badspeak and newspeak are always the first two categories
+    char *files[CATEGORY_MAX] = { "badspeak.txt", "newspeak.txt" };
+    const char *names[CATEGORY_MAX] = { "badspeak", "newspeak" };
+    uint32_t categories = CATEGORY_FIRST;
+    char *equals = NULL;
+    char *shared = NULL;
+    // sizes given on the command line, an attached dictionary has to match
+    bool sized_table = false, sized_filter = false;
 
     // Parse command line inputs
     // If help was chosen or something went wrong, send user to
@@ -79,18 +126,120 @@ int main(int argc, char **argv) {
             // verbose printing was chosen
             chosen = insert_set(VERBOSE, chosen);
             break;
+        case 'u':
+            // UTF-8 tokenizer was chosen
+            chosen = insert_set(UNICODE, chosen);
+            break;
+        case 'z':
+            // tier-zero prefilter was chosen
+            chosen = insert_set(PREFILTER, chosen);
+            break;
+        case 'e':
+            // fuzzy matching was chosen
+            chosen = insert_set(FUZZY, chosen);
+            break;
+        case 'c':
+            // freezing the hash table was chosen
+            chosen = insert_set(FREEZE, chosen);
+            break;
+        case 'a':
+            // pipelined stdin was chosen
+            chosen = insert_set(PIPELINE, chosen);
+            break;
+        case 'd':
+            // the trie lookup engine was chosen
+            chosen = insert_set(TRIE, chosen);
+            break;
+        case 'i':
+            // stem lookups for inflected words were chosen
+            chosen = insert_set(STEM, chosen);
+            break;
+        case 'g':
+            // a shared dictionary segment was named
+            shared = optarg;
+            break;
+        case 'l':
+            // publishing a new version of the shared dictionary was chosen
+            chosen = insert_set(RELOAD, chosen);
+            break;
+        case 'v':
+            // verdict-only classification was chosen
+            chosen = insert_set(VERDICT, chosen);
+            break;
+        case 'm':
+            // look-alike map chosen, which turns on fuzzy matching
+            map = optarg;
+            chosen = insert_set(FUZZY, chosen);
+            break;
+        case 'k':
+            // a named category file chosen
+            equals = strchr(optarg, '=');
+            if (!equals || equals == optarg || !equals[1] || categories == CATEGORY_MAX) {
+                printf("Invalid category.\n");
+                return 1;
+            }
+            *equals = '\0';
+            names[categories] = optarg;
+            files[categories] = equals + 1;
+            categories += 1;
+            break;
+        case 'r':
+            // salt seed chosen, instead of a random one
+            salts_seed((uint64_t) strtoull(optarg, NULL, 0));
+            break;
         case 'f':
             // bloom filter size chosen
-            filter_size = (uint64_t) strtoul(optarg, NULL, 10);
+            filter_size = (uint64_t) strtoull(optarg, NULL, 10);
+            sized_filter = true;
+            break;
+        case 'p':
+            // scalable bloom filter chosen, with a target false positive rate
+            fp_rate = strtod(optarg, NULL);
+            if (fp_rate <= 0 || fp_rate >= 1) {
+                printf("Invalid false positive rate.\n");
+                return 1;
+            }
             break;
         case 't':
             // hash table size chosen
-            if (strtol(optarg, NULL, 10) < 0 || strtol(optarg, NULL, 10) > 598048253) {
+            if (strtoll(optarg, NULL, 10) < 0
+                || strtoull(optarg, NULL, 10) > SIZE_MAX / sizeof(Node *)) {
                 // the table size given is less than 0 (negative) or too large
                 printf("Failed to create hash table.\n");
                 return 1;
             }
-            table_size = (uint64_t) strtoul(optarg, NULL, 10);
+            table_size = (uint64_t) strtoull(optarg, NULL, 10);
+            sized_table = true;
+            break;
+        case 'j':
+            // number of loader threads chosen
+            threads = (uint32_t) strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            // NUMA placement chosen
+            if (!strcmp(optarg, "local")) {
+                mem_set_policy(MEM_LOCAL);
+            } else if (!strcmp(optarg, "interleave")) {
+                mem_set_policy(MEM_INTERLEAVE);
+            } else if (!strcmp(optarg, "replicate")) {
+                mem_set_policy(MEM_REPLICATE);
+            } else {
+                message();
+                return 1;
+            }
+            break;
+        case 'o':
+            // report format chosen
+            if (!strcmp(optarg, "text")) {
+                format = REPORT_TEXT;
+            } else if (!strcmp(optarg, "json")) {
+                format = REPORT_JSON;
+            } else if (!strcmp(optarg, "binary")) {
+                format = REPORT_BINARY;
+            } else {
+                message();
+                return 1;
+            }
             break;
         default: message(); return 1;
         }
@@ -105,65 +254,196 @@ int main(int argc, char **argv) {
         printf("Invalid hash table size.\n");
         return 1;
     }
+    if (threads == 0) {
+        printf("Invalid number of threads.\n");
+        return 1;
+    }
+    if (member_set(VERDICT, chosen) && optind < argc) {
+        // a class is given for one message, which is stdin
+        message();
+        return 1;
+    }
+    if ((shared && (member_set(FUZZY, chosen) || member_set(TRIE, chosen)))
+        || (!shared && member_set(RELOAD, chosen))) {
+        // the fuzzy index and the trie are not part of a shared dictionary
+        message();
+        return 1;
+    }
 
-    // opening files
-    FILE *bad = fopen("badspeak.txt", "r");
-    FILE *new = fopen("newspeak.txt", "r");
+    // a dictionary another process already published is attached, not loaded
+    Set options = empty_set();
+    options = member_set(UNICODE, chosen) ? insert_set(SEGMENT_UNICODE, options) : options;
+    options = member_set(PREFILTER, chosen) ? insert_set(SEGMENT_PREFILTER, options) : options;
+    Segment *segment = shared && !member_set(RELOAD, chosen) ? segment_attach(shared) : NULL;
+    Dictionary dict = { NULL, NULL, NULL, NULL, 0, NULL, 0, NULL, NULL, names, categories, NULL,
+        member_set(STEM, chosen) };
+    if (segment && segment_options(segment) != options) {
+        // words were folded or filtered another way
+        fprintf(stderr, "Shared dictionary was loaded with other options (-u, -z).\n");
+        segment_detach(&segment);
+        return 1;
+    }
+    bool attached = segment && segment_dictionary(segment, &dict);
+    if (segment && !attached) {
+        fprintf(stderr, "Failed to attach the shared dictionary.\n");
+    }
+    bool differs = attached
+                   && ((sized_table && ht_size(dict.ht) != table_size)
+                       || (sized_filter && (bf_scalable(dict.bf) || bf_size(dict.bf) != filter_size))
+                       || (fp_rate && bf_target(dict.bf) != fp_rate)
+                       || (categories > CATEGORY_FIRST && categories != dict.categories));
+    for (uint32_t c = CATEGORY_FIRST; attached && !differs && c < categories; c += 1) {
+        differs = strcmp(names[c], dict.category_names[c]) != 0;
+    }
+    if (differs) {
+        // the segment's table, filter and categories are the ones probed
+        fprintf(stderr, "Shared dictionary was loaded with other sizes (-t, -f, -p, -k).\n");
+    }
+    if (segment && (!attached || differs)) {
+        bf_delete(&dict.bf);
+        ht_delete(&dict.ht);
+        pf_delete(&dict.pf);
+        bf_delete(&dict.phrases);
+        segment_detach(&segment);
+        return 1;
+    }
 
     // create a bloom filter
-    BloomFilter *bf = bf_create(filter_size);
-    HashTable *ht = ht_create(table_size);
-
-    char oldspeak[1024] = "";
-    char newspeak[1024] = "";
-    // read in a list of badspeak words and add it to the bloom filter
-    while (fscanf(bad, "%s\n", oldspeak) != -1) {
-        bf_insert(bf, oldspeak);
-        ht_insert(ht, oldspeak, NULL);
+    BloomFilter *bf = segment ? dict.bf
+                      : fp_rate ? bf_create_scalable(fp_rate)
+                                : bf_create(filter_size);
+    HashTable *ht = segment ? dict.ht : ht_create(table_size);
+    // the prefilter is only built if it was asked for
+    Prefilter *pf = segment ? dict.pf : member_set(PREFILTER, chosen) ? pf_create() : NULL;
+    if (!bf || !ht) {
+        // not enough memory for the sizes given
+        printf(bf ? "Failed to create hash table.\n" : "Failed to create Bloom filter.\n");
+        bf_delete(&bf);
+        ht_delete(&ht);
+        pf_delete(&pf);
+        return 1;
     }
 
-    while (fscanf(new, "%s %s\n", oldspeak, newspeak) != -1) {
-        bf_insert(bf, oldspeak);
-        ht_insert(ht, oldspeak, newspeak);
+    // read in the lists of badspeak and newspeak words and add them to the
+    // bloom filter and hash table
+    dict.bf = bf;
+    dict.ht = ht;
+    dict.pf = pf;
+    if (member_set(FUZZY, chosen)) {
+        dict.fuzzy = fuzzy_create(map);
+        // look-alike characters stay inside words, verdict_check() still
+        // looks up the words around them as written first
+        utf8_word_chars(dict.fuzzy ? fuzzy_chars(dict.fuzzy) : "");
     }
-
-    // regex compile, made like in instructions
-    regex_t re;
-    if (regcomp(&re, "[a-zA-Z0-9_'-]+", REG_EXTENDED)) {
-        fprintf(stderr, "Failed to compile regex.\n");
-        // close files and clear memory
+    if (!segment
+        && ((member_set(FUZZY, chosen) && !dict.fuzzy)
+            || !load_dictionary(files, categories, &dict, member_set(UNICODE, chosen), threads))) {
+        fprintf(stderr, "Failed to load the dictionary files.\n");
         bf_delete(&bf);
         ht_delete(&ht);
-        fclose(new);
-        fclose(bad);
+        pf_delete(&pf);
+        bf_delete(&dict.phrases);
+        fuzzy_delete(&dict.fuzzy);
         return 1;
     }
 
-    // making two binary search trees to hold the bad words
-    char *word = "";
-    Node *badwords_list = bst_create();
-    Node *badwords_list_with_newspeak = bst_create();
-    // reading and filtering words
-    while ((word = next_word(stdin, &re)) != NULL) {
-        // make the word lowercase
-        word = lower(word);
-        if (bf_probe(bf, word)) {
-            // word is probably in bloom filter
-            Node *n = ht_lookup(ht, word);
-            if (n && !n->newspeak) {
-                // there is no newspeak, thoughtcrime
-                punishment = insert_set(THOUGHTCRIME, punishment);
-                badwords_list = bst_insert(badwords_list, word, NULL);
+    if (member_set(FREEZE, chosen) && !ht_freeze(ht)) {
+        // the table still works as trees
+        fprintf(stderr, "Failed to freeze hash table.\n");
+    }
+    if (member_set(TRIE, chosen) && !(dict.trie = trie_create(ht))) {
+        // words are still found through the hash table
+        fprintf(stderr, "Failed to build trie.\n");
+    }
+    if (shared && !segment && !segment_publish(shared, &dict, options)) {
+        // this run still has its own copy
+        fprintf(stderr, "Failed to publish the shared dictionary.\n");
+    }
+    if (mem_get_policy() == MEM_REPLICATE) {
+        // copy the finished bloom filter onto every NUMA node
+        dict.nodes = mem_nodes();
+        dict.replicas = (BloomFilter **) calloc(dict.nodes, sizeof(BloomFilter *));
+        for (uint32_t n = 0; dict.replicas && n < dict.nodes; n += 1) {
+            dict.replicas[n] = bf_copy(bf, (int) n);
+            if (!dict.replicas[n]) {
+                // fall back to the shared filter on that node
+                dict.replicas[n] = bf;
             }
-            if (n && n->newspeak) {
-                // contains word and newspeak, needs counseling on Rightspeak
-                punishment = insert_set(RIGHTSPEAK, punishment);
-                badwords_list_with_newspeak
-                    = bst_insert(badwords_list_with_newspeak, word, n->newspeak);
+        }
+    }
+    if (member_set(VERBOSE, chosen)) {
+        // count which words are hit, in memory fixed from here on
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        dict.freq = freq_create(cores > 0 ? (uint32_t) cores : 1);
+    }
+    Verdict verdict = { empty_set(), empty_set(), bst_create(), bst_create(), bst_create(), 0, 0, 0,
+        0, 0, 0, { { NULL }, { 0 }, { 0 }, 0, 0, 0 }, member_set(VERDICT, chosen) };
+    bool batch = optind < argc;
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (batch) {
+        // files were named, check each one and print a report per file
+        if (!batch_run(argv + optind, argc - optind, &dict, threads, !member_set(UNICODE, chosen),
+                member_set(VERBOSE, chosen), format, &verdict)) {
+            fprintf(stderr, "Failed to run batch.\n");
+            bf_delete(&bf);
+            ht_delete(&ht);
+            pf_delete(&pf);
+            return 1;
+        }
+    } else if (member_set(PIPELINE, chosen) && !member_set(VERDICT, chosen)) {
+        // reader and tokenizer take two threads, the rest match
+        if (!pipeline_run(STDIN_FILENO, &dict, threads > 2 ? threads - 2 : 1,
+                !member_set(UNICODE, chosen), &verdict)) {
+            fprintf(stderr, "Failed to read stdin.\n");
+        }
+    } else {
+        // regex compile, made like in instructions
+        regex_t re;
+        char pattern[192] = "[a-zA-Z0-9_'";
+        for (const char *c = dict.fuzzy ? fuzzy_chars(dict.fuzzy) : ""; *c; c += 1) {
+            if (!strchr("[]^\\-", *c)) {
+                // look-alike characters are part of words too
+                strncat(pattern, c, 1);
             }
         }
+        strcat(pattern, "-]+");
+        if (regcomp(&re, pattern, REG_EXTENDED)) {
+            fprintf(stderr, "Failed to compile regex.\n");
+            // close files and clear memory
+            bf_delete(&bf);
+            ht_delete(&ht);
+            pf_delete(&pf);
+            return 1;
+        }
+
+        char *word = "";
+        Dictionary local = dictionary_local(&dict);
+        // the built-in tokenizer already hands back folded words, and it is
+        // the one that can walk the trie
+        Scanner *scanner = member_set(UNICODE, chosen) || dict.trie
+                               ? scanner_create(stdin, !member_set(UNICODE, chosen))
+                               : NULL;
+        if (scanner) {
+            verdict_scan(&verdict, &local, scanner);
+        }
+        // reading and filtering words, a verdict-only run stops reading
+        // once no word can change the class
+        while (!scanner && !(verdict.quick && verdict_decided(&verdict))
+               && (word = next_word(stdin, &re)) != NULL) {
+            // make the word lowercase
+            word = lower(word);
+            verdict_check(&verdict, &local, word);
+        }
+        scanner_delete(&scanner);
+        clear_words();
+        regfree(&re);
     }
 
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double seconds = (double) (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+
     // print statistics OR print the crime message
     if (member_set(VERBOSE, chosen)) {
         // average BST SIZE
@@ -171,42 +451,104 @@ int main(int argc, char **argv) {
         // average BST height
         printf("Average BST height: %.6lf\n", (double) ht_avg_bst_height(ht));
         // average branches traversed
-        printf("Average branches traversed: %.6lf\n", (double) branches / lookups);
+        printf("Average branches traversed: %.6lf\n",
+            lookups ? (double) branches / (double) lookups : 0.0);
         // hash table load
         printf("Hash table load: %.6lf%%\n", 100 * ((double) ht_count(ht) / (double) ht_size(ht)));
         // bloom filter load
         printf(
             "Bloom filter load: %.6lf%%\n", 100 * ((double) bf_count(bf) / (double) bf_size(bf)));
-    } else {
-        // if there are "bad words" indicated
-        // thoughtcrime and rightspeak counselling
-        if (member_set(THOUGHTCRIME, punishment) && member_set(RIGHTSPEAK, punishment)) {
-            printf("%s", mixspeak_message);
-            bst_print(badwords_list);
-            bst_print(badwords_list_with_newspeak);
+        // how likely a clean word is to get past the bloom filter
+        printf("Bloom filter false positive rate: %.6lf%%\n", 100 * bf_fp_rate(bf));
+        // memory used by the bloom filter and hash table
+        printf("Bloom filter memory: %" PRIu64 " bytes\n", bf_bytes(bf));
+        printf("Hash table memory: %" PRIu64 " bytes\n", ht_bytes(ht));
+        // page sizes the big arrays actually got
+        printf("Bloom filter page size: %zu KB\n", bf_page_size(bf) / 1024);
+        printf("Hash table page size: %zu KB\n", ht_page_size(ht) / 1024);
+        if (pf) {
+            // share of words the prefilter rejected before any hashing
+            printf("Tier-zero rejections: %.6lf%%\n",
+                verdict.scanned ? 100 * ((double) verdict.rejected / (double) verdict.scanned)
+                                : 0.0);
+        }
+        if (dict.fuzzy) {
+            // what the fuzzy index costs, and what it caught
+            printf("Fuzzy index memory: %" PRIu64 " bytes\n", fuzzy_bytes(dict.fuzzy));
+            printf("Fuzzy probes per word: %.6lf\n",
+                verdict.scanned ? (double) verdict.probes / (double) verdict.scanned : 0.0);
+            printf("Fuzzy matches: %" PRIu64 "\n", verdict.fuzzed);
+        }
+        if (dict.stems) {
+            // inflected words only the stem table caught
+            printf("Stem matches: %" PRIu64 "\n", verdict.stemmed);
+        }
+        if (dict.trie) {
+            // what the trie costs next to the filter and table above
+            printf("Trie memory: %" PRIu64 " bytes\n", trie_bytes(dict.trie));
+            printf("Trie slots: %" PRIu32 "\n", trie_slots(dict.trie));
         }
-        // thoughtcrime and not rightspeak counselling
-        if (member_set(THOUGHTCRIME, punishment) && !member_set(RIGHTSPEAK, punishment)) {
-            printf("%s", badspeak_message);
-            bst_print(badwords_list);
-            bst_print(badwords_list_with_newspeak);
+        // how fast words were checked, with whichever engine ran
+        printf("Scan throughput: %.6lf words/s\n",
+            seconds > 0 ? (double) verdict.scanned / seconds : 0.0);
+        // the salts this run used, and whether a tree got too deep
+        printf("Hash seed: 0x%016" PRIx64 "\n", segment ? segment_seed(segment) : salts_get_seed());
+        printf("Hash table rehashes: %" PRIu32 "\n", ht_rehashes(ht));
+        printf("Deepest hash table tree: %" PRIu32 "\n", ht_max_height(ht));
+        if (segment) {
+            // which shared dictionary this run probed
+            printf("Shared dictionary version: %" PRIu64 "\n", segment_version(segment));
+            printf("Shared dictionary memory: %" PRIu64 " bytes\n", segment_bytes(segment));
         }
-        // rightspeak counselling and not thoughtcrime
-        if (!member_set(THOUGHTCRIME, punishment) && member_set(RIGHTSPEAK, punishment)) {
-            printf("%s", goodspeak_message);
-            bst_print(badwords_list);
-            bst_print(badwords_list_with_newspeak);
+        // share of words the hot word cache answered
+        printf("Hot word cache hit rate: %.6lf%%\n",
+            verdict.scanned ? 100 * ((double) verdict.cached / (double) verdict.scanned) : 0.0);
+        if (dict.freq) {
+            // which words were hit most, from the sketches
+            Node *top[FREQ_TOP];
+            uint64_t counts[FREQ_TOP];
+            uint32_t found = freq_top(dict.freq, top, counts, FREQ_TOP);
+            uint64_t error = freq_error(dict.freq);
+            printf("Violations counted: %" PRIu64 "\n", freq_total(dict.freq));
+            printf("Distinct violations (estimated): %" PRIu64 "\n", freq_distinct(dict.freq));
+            printf("Violation statistics memory: %" PRIu64 " bytes\n", freq_bytes(dict.freq));
+            for (uint32_t i = 0; i < found; i += 1) {
+                printf("Top violation: %s %" PRIu64 " (over by at most %" PRIu64 ")\n",
+                    top[i]->oldspeak, counts[i], error);
+            }
+        }
+    } else if (verdict.quick) {
+        // one byte, the punishment bits as in binary reports
+        putchar('0' + member_set(THOUGHTCRIME, verdict.punishment)
+                + 2 * member_set(RIGHTSPEAK, verdict.punishment));
+    } else if (!batch) {
+        Report *report = report_create(STDOUT_FILENO, format, NULL);
+        if (report) {
+            report_categories(report, dict.category_names, dict.categories);
+            report_verdict(report, NULL, &verdict);
+            report_delete(&report);
         }
     }
 
     // clear memory allocated, and close files
+    for (uint32_t n = 0; dict.replicas && n < dict.nodes; n += 1) {
+        if (dict.replicas[n] != bf) {
+            bf_delete(&dict.replicas[n]);
+        }
+    }
+    free(dict.replicas);
     bf_delete(&bf);
     ht_delete(&ht);
-    bst_delete(&badwords_list);
-    bst_delete(&badwords_list_with_newspeak);
-    clear_words();
-    regfree(&re);
-    fclose(new);
-    fclose(bad);
-    return 0;
+    pf_delete(&pf);
+    bf_delete(&dict.phrases);
+    fuzzy_delete(&dict.fuzzy);
+    freq_delete(&dict.freq);
+    trie_delete(&dict.trie);
+    segment_detach(&segment);
+    // a verdict-only run exits with 0 if clean, otherwise 1 plus the bits
+    Set punishment = verdict.quick ? verdict.punishment : empty_set();
+    verdict_delete(&verdict);
+    return punishment ? 1 + (int) (member_set(THOUGHTCRIME, punishment)
+                                   + 2 * member_set(RIGHTSPEAK, punishment))
+                      : 0;
 }
@@ -0,0 +1,398 @@
+// Batch mode: checks many files against one loaded dictionary. Files are
+// cut into units of about BATCH_CHUNK bytes (large files into several,
+// small files into one each), units are grouped into tasks of about the
+// same size, and the tasks run on the work-stealing pool. When the last
+// unit of a file is done its findings are merged and its report printed.
+#include "batch.h"
+#include "bst.h"
+#include "phrase.h"
+#include "pool.h"
+#include "scanner.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BATCH_CHUNK (1 << 20)
+
+// Structure for one input file
+// path = where the file is
+// size = how big the file was when the batch started
+// chunks = how many units the file was cut into
+// remaining = units not finished yet
+// verdicts = one per unit, merged into the first when all are done
+
+typedef struct {
+    char *path;
+    uint64_t size;
+    uint32_t chunks;
+    atomic_uint remaining;
+    Verdict *verdicts;
+} BatchFile;
+
+// Structure for one unit of work, a piece of a file
+// file = index of the file
+// chunk = which piece of the file
+
+typedef struct {
+    size_t file;
+    uint32_t chunk;
+} Unit;
+
+// Structure for the whole batch, shared by the workers
+// files, units = every file and unit
+// tasks = index of the first unit of each task, plus one past the end
+// output = keeps reports from being interleaved
+// reports = one report writer per worker
+// counts = branches, lookups, scanned, rejected, fuzzy probes, fuzzy
+// matches, cached words and stem matches per worker
+
+typedef struct {
+    Dictionary *dict;
+    bool ascii;
+    bool quiet;
+    BatchFile *files;
+    size_t file_count;
+    Unit *units;
+    size_t *tasks;
+    pthread_mutex_t output;
+    Report **reports;
+    uint64_t (*counts)[8];
+} Batch;
+
+// Structure for a growing list of paths
+
+typedef struct {
+    char **paths;
+    size_t count;
+    size_t capacity;
+} PathList;
+
+// The path_add() function adds a copy of a path to the list
+// Inputs: the list, the path
+// Outputs: true if it could be added
+
+static bool path_add(PathList *list, const char *path) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? 2 * list->capacity : 64;
+        char **bigger = (char **) realloc(list->paths, list->capacity * sizeof(char *));
+        if (!bigger) {
+            return false;
+        }
+        list->paths = bigger;
+    }
+    list->paths[list->count] = strdup(path);
+    return list->paths[list->count++] != NULL;
+}
+
+// The path_expand() function adds a file, or every file under a directory
+// Inputs: the list, the path
+// Outputs: true unless memory ran out
+
+static bool path_expand(PathList *list, const char *path) {
+    struct stat info;
+    if (stat(path, &info) == 0 && S_ISDIR(info.st_mode)) {
+        DIR *dir = opendir(path);
+        if (!dir) {
+            fprintf(stderr, "banhammer: %s: %s\n", path, strerror(errno));
+            return true;
+        }
+        bool ok = true;
+        struct dirent *entry;
+        while (ok && (entry = readdir(dir)) != NULL) {
+            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+                continue;
+            }
+            char *child = (char *) malloc(strlen(path) + strlen(entry->d_name) + 2);
+            if (!child) {
+                ok = false;
+                break;
+            }
+            sprintf(child, "%s/%s", path, entry->d_name);
+            ok = path_expand(list, child);
+            free(child);
+        }
+        closedir(dir);
+        return ok;
+    }
+    return path_add(list, path);
+}
+
+// The boundary() function moves a cut point forward to the next
+// whitespace byte, so no word (or multibyte character) is split
+// Inputs: the file's bytes, its size, the cut point
+// Outputs: where the piece really starts or ends
+
+static size_t boundary(const char *data, size_t size, size_t pos) {
+    if (pos == 0) {
+        return 0;
+    }
+    while (pos < size && !isspace((unsigned char) data[pos])) {
+        pos += 1;
+    }
+    return pos < size ? pos : size;
+}
+
+// The lookback() function moves a start point back over a few runs of
+// non-whitespace bytes
+// Inputs: the file's bytes, the start point, how many runs
+// Outputs: where the runs start
+
+static size_t lookback(const char *data, size_t pos, uint64_t runs) {
+    for (uint64_t i = 0; i < runs && pos > 0; i += 1) {
+        while (pos > 0 && isspace((unsigned char) data[pos - 1])) {
+            pos -= 1;
+        }
+        while (pos > 0 && !isspace((unsigned char) data[pos - 1])) {
+            pos -= 1;
+        }
+    }
+    return pos;
+}
+
+// The prime_unit() function puts the words just before a piece of a file
+// into the phrase window, so phrases that cross into the piece are found.
+// Runs of bytes without a word in them do not count, so it goes back
+// further until there are enough words or the file starts
+// Inputs: the batch, the dictionary to use, the file's bytes, where the
+// piece starts, where the findings go
+// Outputs: void
+
+static void prime_unit(Batch *b, Dictionary *dict, const char *data, size_t start, Verdict *v) {
+    for (uint64_t runs = PHRASE_MAX - 1;; runs *= 2) {
+        size_t from = lookback(data, start, runs);
+        Scanner *s = scanner_create_buffer(data + from, start - from, b->ascii);
+        if (!s) {
+            return;
+        }
+        uint64_t words = verdict_prime(v, dict, s);
+        scanner_delete(&s);
+        if (words >= PHRASE_MAX - 1 || from == 0) {
+            return;
+        }
+        // start over with a longer look back
+        window_delete(&v->window);
+    }
+}
+
+// The scan_unit() function scans one piece of a file
+// Inputs: the batch, the dictionary to use, the unit, where the
+// findings go
+// Outputs: void
+
+static void scan_unit(Batch *b, Dictionary *dict, Unit *u, Verdict *v) {
+    BatchFile *f = &b->files[u->file];
+    int fd = open(f->path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        if (u->chunk == 0) {
+            fprintf(stderr, "banhammer: %s: %s\n", f->path, strerror(errno));
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    size_t size = (size_t) info.st_size;
+    char *data = size ? (char *) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    if (data == MAP_FAILED) {
+        if (u->chunk == 0) {
+            fprintf(stderr, "banhammer: %s: %s\n", f->path, strerror(errno));
+        }
+        return;
+    }
+    if (size) {
+        size_t start = boundary(data, size, (size_t) u->chunk * BATCH_CHUNK);
+        size_t end = u->chunk + 1 == f->chunks
+                         ? size
+                         : boundary(data, size, (size_t) (u->chunk + 1) * BATCH_CHUNK);
+        Scanner *s = start < end ? scanner_create_buffer(data + start, end - start, b->ascii) : NULL;
+        if (s && start > 0 && dict->phrases) {
+            prime_unit(b, dict, data, start, v);
+        }
+        if (s) {
+            verdict_scan(v, dict, s);
+        }
+        scanner_delete(&s);
+        munmap(data, size);
+    }
+    return;
+}
+
+// The finish_file() function merges a finished file's findings and
+// prints its report
+// Inputs: the batch, the file, the worker that finished it
+// Outputs: void
+
+static void finish_file(Batch *b, BatchFile *f, uint32_t worker) {
+    for (uint32_t c = 1; c < f->chunks; c += 1) {
+        verdict_merge(&f->verdicts[0], &f->verdicts[c]);
+        verdict_delete(&f->verdicts[c]);
+    }
+    if (!b->quiet) {
+        // written out under the output lock once the buffer fills up
+        report_verdict(b->reports[worker], f->path, &f->verdicts[0]);
+    }
+    verdict_delete(&f->verdicts[0]);
+    return;
+}
+
+// The run_task() function is called by the pool for every task
+// Inputs: the task, the worker running it, the batch
+// Outputs: void
+
+static void run_task(size_t task, uint32_t worker, void *arg) {
+    Batch *b = (Batch *) arg;
+    // probe the bloom filter copy closest to this worker
+    Dictionary local = dictionary_local(b->dict);
+    uint64_t branches_before = branches;
+    uint64_t lookups_before = lookups;
+    for (size_t i = b->tasks[task]; i < b->tasks[task + 1]; i += 1) {
+        Unit *u = &b->units[i];
+        BatchFile *f = &b->files[u->file];
+        Verdict *v = &f->verdicts[u->chunk];
+        scan_unit(b, &local, u, v);
+        b->counts[worker][2] += v->scanned;
+        b->counts[worker][3] += v->rejected;
+        b->counts[worker][4] += v->probes;
+        b->counts[worker][5] += v->fuzzed;
+        b->counts[worker][6] += v->cached;
+        b->counts[worker][7] += v->stemmed;
+        if (atomic_fetch_sub(&f->remaining, 1) == 1) {
+            // last piece of this file
+            finish_file(b, f, worker);
+        }
+    }
+    b->counts[worker][0] += branches - branches_before;
+    b->counts[worker][1] += lookups - lookups_before;
+    return;
+}
+
+// The batch_run() function checks every file named on the command line
+// (a directory means every file under it, and - means read a list of
+// paths from stdin) and prints one report per file
+// Inputs: the paths and how many, the dictionary, the number of threads,
+// whether only ASCII letters make words, whether to skip the reports,
+// the report format, and the verdict that collects the totals for the statistics
+// Outputs: true if the batch could be run
+
+bool batch_run(char **paths, int count, Dictionary *dict, uint32_t threads, bool ascii, bool quiet,
+    ReportFormat format, Verdict *total) {
+    PathList list = { NULL, 0, 0 };
+    bool ok = true;
+    for (int i = 0; ok && i < count; i += 1) {
+        if (!strcmp(paths[i], "-")) {
+            // one path per line on stdin
+            char *line = NULL;
+            size_t capacity = 0;
+            ssize_t length;
+            while (ok && (length = getline(&line, &capacity, stdin)) > 0) {
+                if (line[length - 1] == '\n') {
+                    line[length - 1] = '\0';
+                }
+                if (line[0]) {
+                    ok = path_expand(&list, line);
+                }
+            }
+            free(line);
+        } else {
+            ok = path_expand(&list, paths[i]);
+        }
+    }
+
+    Batch b = { dict, ascii, quiet, NULL, list.count, NULL, NULL, PTHREAD_MUTEX_INITIALIZER, NULL,
+        NULL };
+    b.files = (BatchFile *) calloc(list.count + 1, sizeof(BatchFile));
+    ok = ok && b.files;
+
+    // cut the files into units
+    size_t unit_count = 0;
+    for (size_t i = 0; ok && i < list.count; i += 1) {
+        struct stat info;
+        uint64_t size = stat(list.paths[i], &info) == 0 ? (uint64_t) info.st_size : 0;
+        b.files[i].path = list.paths[i];
+        b.files[i].size = size;
+        b.files[i].chunks = size ? (uint32_t) ((size + BATCH_CHUNK - 1) / BATCH_CHUNK) : 1;
+        atomic_init(&b.files[i].remaining, b.files[i].chunks);
+        b.files[i].verdicts = (Verdict *) calloc(b.files[i].chunks, sizeof(Verdict));
+        ok = b.files[i].verdicts != NULL;
+        unit_count += b.files[i].chunks;
+    }
+    b.units = (Unit *) calloc(unit_count + 1, sizeof(Unit));
+    b.tasks = (size_t *) calloc(unit_count + 1, sizeof(size_t));
+    b.counts = calloc(threads, sizeof(*b.counts));
+    b.reports = (Report **) calloc(threads, sizeof(Report *));
+    ok = ok && b.units && b.tasks && b.counts && b.reports;
+    for (uint32_t t = 0; ok && t < threads; t += 1) {
+        b.reports[t] = report_create(STDOUT_FILENO, format, &b.output);
+        ok = b.reports[t] != NULL;
+        if (ok) {
+            report_categories(b.reports[t], dict->category_names, dict->categories);
+        }
+    }
+
+    // group units into tasks of about BATCH_CHUNK bytes, so small files
+    // are batched together and big files are spread over the workers
+    size_t task_count = 0;
+    if (ok) {
+        size_t u = 0;
+        uint64_t bytes = BATCH_CHUNK;
+        for (size_t i = 0; i < list.count; i += 1) {
+            uint64_t size = b.files[i].size;
+            for (uint32_t c = 0; c < b.files[i].chunks; c += 1) {
+                uint64_t piece = size > (uint64_t) c * BATCH_CHUNK ? size - (uint64_t) c * BATCH_CHUNK : 0;
+                piece = piece < BATCH_CHUNK ? piece : BATCH_CHUNK;
+                if (bytes >= BATCH_CHUNK) {
+                    b.tasks[task_count++] = u;
+                    bytes = 0;
+                }
+                bytes += piece + 1;
+                b.units[u].file = i;
+                b.units[u].chunk = c;
+                u += 1;
+            }
+        }
+        b.tasks[task_count] = unit_count;
+        ok = pool_run(threads, task_count, run_task, &b);
+    }
+
+    for (uint32_t t = 0; b.reports && t < threads; t += 1) {
+        // writes out whatever each worker still has buffered
+        report_delete(&b.reports[t]);
+    }
+    for (uint32_t t = 0; b.counts && t < threads; t += 1) {
+        // the workers' counts are thread local, add them here
+        branches += b.counts[t][0];
+        lookups += b.counts[t][1];
+        total->scanned += b.counts[t][2];
+        total->rejected += b.counts[t][3];
+        total->probes += b.counts[t][4];
+        total->fuzzed += b.counts[t][5];
+        total->cached += b.counts[t][6];
+        total->stemmed += b.counts[t][7];
+    }
+    for (size_t i = 0; b.files && i < list.count; i += 1) {
+        free(b.files[i].verdicts);
+    }
+    for (size_t i = 0; i < list.count; i += 1) {
+        free(list.paths[i]);
+    }
+    free(list.paths);
+    free(b.files);
+    free(b.units);
+    free(b.tasks);
+    free(b.counts);
+    free(b.reports);
+    pthread_mutex_destroy(&b.output);
+    return ok;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "report.h"
+#include "verdict.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool batch_run(char **paths, int count, Dictionary *dict, uint32_t threads, bool ascii, bool quiet,
+    ReportFormat format, Verdict *total);
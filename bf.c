@@ -6,39 +6,98 @@
 #include "salts.h"
 #include "speck.h"
 
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+// Scalable mode: the first slice is sized for this many words, every new
+// slice holds twice as many, and aims for a false positive rate this
+// much tighter than the one before it
+#define BF_MAX_SLICES  32
+#define BF_FIRST_SLICE 4096
+#define BF_TIGHTEN     0.5
+
+// Structure for one slice of a scalable bloom filter
+// bits = the slice's bit vector
+// hashes = number of bits set per word
+// capacity = number of words the slice is sized for
+// inserted = number of words put in it so far
+
+typedef struct {
+    BitVector *bits;
+    uint32_t hashes;
+    uint64_t capacity;
+    uint64_t inserted;
+} Slice;
 
 // Structure for Bloom Filter
 // primary = primary hash function salt
 // secondary = secondary hash function salt
 // tertiary = tertiary hash function salt
+// filter = the bit vector of a fixed size filter, null in scalable mode
+// fp = target false positive rate in scalable mode
+// slices = how many slices of chain are in use, newest last
+// lock = taken to add a slice, words are inserted and probed without it
+// generation = unique to this filter, drawn again when inserts are published
 
 struct BloomFilter {
     uint64_t primary[2];
     uint64_t secondary[2];
     uint64_t tertiary[2];
     BitVector *filter;
+    double fp;
+    uint32_t slices;
+    Slice chain[BF_MAX_SLICES];
+    pthread_mutex_t lock;
+    uint64_t generation;
 };
 
+// Structure for the head of a filter image, as bf_export() writes it. A
+// fixed size filter's bits follow it, a scalable filter's slices follow
+// it as a Part and then the slice's bits
+// primary, secondary, tertiary = the salts the filter was built with
+// fp = target false positive rate, 0 for a fixed size filter
+// slices = how many slices follow
+
+typedef struct {
+    uint64_t primary[2];
+    uint64_t secondary[2];
+    uint64_t tertiary[2];
+    double fp;
+    uint64_t slices;
+} Image;
+
+// Structure for the head of one slice in a filter image
+// hashes, capacity, inserted = as in Slice
+
+typedef struct {
+    uint64_t hashes;
+    uint64_t capacity;
+    uint64_t inserted;
+} Part;
+
 // The bf_create() function constructs a bloom filter
 // Inputs: the size of the bloom filter
 // Outputs: a pointer to the bloom filter
 
-BloomFilter *bf_create(uint32_t size) {
-    BloomFilter *bf = (BloomFilter *) calloc(size, sizeof(BloomFilter));
+BloomFilter *bf_create(uint64_t size) {
+    BloomFilter *bf = (BloomFilter *) calloc(1, sizeof(BloomFilter));
     if (bf) {
         // set salts and create filter
-        bf->primary[0] = (uint64_t) SALT_PRIMARY_LO;
-        bf->primary[1] = (uint64_t) SALT_PRIMARY_HI;
-        bf->secondary[0] = (uint64_t) SALT_SECONDARY_LO;
-        bf->secondary[1] = (uint64_t) SALT_SECONDARY_HI;
-        bf->tertiary[0] = (uint64_t) SALT_TERTIARY_LO;
-        bf->tertiary[1] = (uint64_t) SALT_TERTIARY_HI;
+        salts_get(SALT_PRIMARY, bf->primary);
+        salts_get(SALT_SECONDARY, bf->secondary);
+        salts_get(SALT_TERTIARY, bf->tertiary);
+        bf->fp = 0;
+        bf->slices = 0;
+        bf->generation = salts_generation();
+        pthread_mutex_init(&bf->lock, NULL);
         bf->filter = bv_create(size);
         // if something goes wrong creating the bit vector
         if (!bf->filter) {
             bv_delete(&bf->filter);
+            pthread_mutex_destroy(&bf->lock);
             free(bf);
             bf = NULL;
         }
@@ -46,13 +105,75 @@ BloomFilter *bf_create(uint32_t size) {
     return bf;
 }
 
+// The bf_grow() function adds a slice to a scalable bloom filter
+// Inputs: a pointer to the bloom filter
+// Outputs: true if a slice was added
+
+static bool bf_grow(BloomFilter *bf) {
+    uint32_t i = bf->slices;
+    if (i == BF_MAX_SLICES) {
+        return false;
+    }
+    // the targets add up to at most fp: fp * (1 - r) * (1 + r + r^2 + ...)
+    double target = bf->fp * (1 - BF_TIGHTEN) * pow(BF_TIGHTEN, i);
+    uint64_t capacity = (uint64_t) BF_FIRST_SLICE << i;
+    double bits = ceil((double) capacity * -log(target) / (log(2.0) * log(2.0)));
+    Slice *slice = &bf->chain[i];
+    slice->bits = bv_create((uint64_t) bits);
+    if (!slice->bits) {
+        return false;
+    }
+    slice->hashes = (uint32_t) ceil(log2(1 / target));
+    slice->capacity = capacity;
+    slice->inserted = 0;
+    // probing threads see the slice only once it is filled in
+    __atomic_store_n(&bf->slices, i + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// The bf_create_scalable() function constructs a bloom filter that adds
+// slices as it fills up, keeping its false positive rate under a target
+// Inputs: the target false positive rate (between 0 and 1)
+// Outputs: a pointer to the bloom filter
+
+BloomFilter *bf_create_scalable(double fp) {
+    BloomFilter *bf = (BloomFilter *) calloc(1, sizeof(BloomFilter));
+    if (bf) {
+        // set salts, the slices are made as words come in
+        salts_get(SALT_PRIMARY, bf->primary);
+        salts_get(SALT_SECONDARY, bf->secondary);
+        salts_get(SALT_TERTIARY, bf->tertiary);
+        bf->fp = fp;
+        bf->generation = salts_generation();
+        pthread_mutex_init(&bf->lock, NULL);
+        if (!bf_grow(bf)) {
+            pthread_mutex_destroy(&bf->lock);
+            free(bf);
+            bf = NULL;
+        }
+    }
+    return bf;
+}
+
+// The bf_scalable() function checks if a bloom filter is scalable
+// Inputs: a pointer to the bloom filter
+// Outputs: true if it grows by adding slices
+
+bool bf_scalable(BloomFilter *bf) {
+    return __atomic_load_n(&bf->slices, __ATOMIC_ACQUIRE) > 0;
+}
+
 // The bf_delete() function destructs the bloom filter
 // Inputs: pointer to the pointer to a bloom filter
 // Outputs: void
 
 void bf_delete(BloomFilter **bf) {
-    if (*bf && (*bf)->filter) {
+    if (*bf) {
         bv_delete(&(*bf)->filter);
+        for (uint32_t i = 0; i < (*bf)->slices; i += 1) {
+            bv_delete(&(*bf)->chain[i].bits);
+        }
+        pthread_mutex_destroy(&(*bf)->lock);
         free(*bf);
         *bf = NULL;
     }
@@ -64,19 +185,69 @@ void bf_delete(BloomFilter **bf) {
 // Inputs: a pointer to the bloom filter
 // Outputs: the length of the bit vector in the bloom filter
 
-uint32_t bf_size(BloomFilter *bf) {
+uint64_t bf_size(BloomFilter *bf) {
+    if (bf_scalable(bf)) {
+        // add up the slices
+        uint64_t size = 0;
+        for (uint32_t i = 0; i < bf->slices; i += 1) {
+            size += bv_length(bf->chain[i].bits);
+        }
+        return size;
+    }
     return bv_length(bf->filter);
 }
 
+// The bf_publish() function draws a new generation once a batch of
+// inserts is done, so answers cached before them are dropped. A probe
+// that sees the new generation sees the bits too
+// Inputs: a pointer to the bloom filter
+// Outputs: void
+
+void bf_publish(BloomFilter *bf) {
+    __atomic_store_n(&bf->generation, salts_generation(), __ATOMIC_RELEASE);
+    return;
+}
+
+// The bf_generation() function gives a number that no other filter, and no
+// other set of words of this filter, has had
+// Inputs: a pointer to the bloom filter
+// Outputs: the generation
+
+uint64_t bf_generation(BloomFilter *bf) {
+    return __atomic_load_n(&bf->generation, __ATOMIC_ACQUIRE);
+}
+
 // The bf_insert() function inserts an oldspeak into the bloom filter
 // Inputs: a pointer to the bloom filter, the oldspeak to be inserted
 // Outputs: void
 
 void bf_insert(BloomFilter *bf, char *oldspeak) {
+    if (bf_scalable(bf)) {
+        uint32_t slices = __atomic_load_n(&bf->slices, __ATOMIC_ACQUIRE);
+        Slice *slice = &bf->chain[slices - 1];
+        if (__atomic_load_n(&slice->inserted, __ATOMIC_RELAXED) >= slice->capacity) {
+            // newest slice is full, the first thread here starts the next one
+            pthread_mutex_lock(&bf->lock);
+            if (bf->slices == slices) {
+                bf_grow(bf);
+            }
+            pthread_mutex_unlock(&bf->lock);
+            slice = &bf->chain[__atomic_load_n(&bf->slices, __ATOMIC_ACQUIRE) - 1];
+        }
+        // k indices from two hashes: h1 + j * h2
+        uint64_t h1 = hash64(bf->primary, oldspeak);
+        uint64_t h2 = hash64(bf->secondary, oldspeak) | 1;
+        uint64_t length = bv_length(slice->bits);
+        for (uint32_t j = 0; j < slice->hashes; j += 1) {
+            bv_set_bit(slice->bits, (h1 + j * h2) % length);
+        }
+        __atomic_fetch_add(&slice->inserted, 1, __ATOMIC_RELAXED);
+        return;
+    }
     // get the indices to use
-    uint32_t pri_index = hash(bf->primary, oldspeak) % bf_size(bf);
-    uint32_t sec_index = hash(bf->secondary, oldspeak) % bf_size(bf);
-    uint32_t ter_index = hash(bf->tertiary, oldspeak) % bf_size(bf);
+    uint64_t pri_index = hash_index(bf->primary, oldspeak, bf_size(bf));
+    uint64_t sec_index = hash_index(bf->secondary, oldspeak, bf_size(bf));
+    uint64_t ter_index = hash_index(bf->tertiary, oldspeak, bf_size(bf));
     // set the bit at given indices
     bv_set_bit(bf->filter, pri_index);
     bv_set_bit(bf->filter, sec_index);
@@ -91,10 +262,28 @@ void bf_insert(BloomFilter *bf, char *oldspeak) {
 // bloom filter
 
 bool bf_probe(BloomFilter *bf, char *oldspeak) {
+    if (bf_scalable(bf)) {
+        // the word could be in any slice
+        uint64_t h1 = hash64(bf->primary, oldspeak);
+        uint64_t h2 = hash64(bf->secondary, oldspeak) | 1;
+        uint32_t slices = __atomic_load_n(&bf->slices, __ATOMIC_ACQUIRE);
+        for (uint32_t i = 0; i < slices; i += 1) {
+            Slice *slice = &bf->chain[i];
+            uint64_t length = bv_length(slice->bits);
+            uint32_t j = 0;
+            while (j < slice->hashes && bv_get_bit(slice->bits, (h1 + j * h2) % length)) {
+                j += 1;
+            }
+            if (j == slice->hashes) {
+                return true;
+            }
+        }
+        return false;
+    }
     // get the indices to use
-    uint32_t pri_index = hash(bf->primary, oldspeak) % bf_size(bf);
-    uint32_t sec_index = hash(bf->secondary, oldspeak) % bf_size(bf);
-    uint32_t ter_index = hash(bf->tertiary, oldspeak) % bf_size(bf);
+    uint64_t pri_index = hash_index(bf->primary, oldspeak, bf_size(bf));
+    uint64_t sec_index = hash_index(bf->secondary, oldspeak, bf_size(bf));
+    uint64_t ter_index = hash_index(bf->tertiary, oldspeak, bf_size(bf));
     // if all three are set, then return true
     if (bv_get_bit(bf->filter, pri_index) && bv_get_bit(bf->filter, sec_index)
         && bv_get_bit(bf->filter, ter_index)) {
@@ -104,19 +293,206 @@ bool bf_probe(BloomFilter *bf, char *oldspeak) {
     }
 }
 
+// The bf_insert_hash() function inserts an item the caller already hashed,
+// used for phrases, whose hash is built up a word at a time
+// Inputs: a pointer to the bloom filter, the 64-bit hash
+// Outputs: void
+
+void bf_insert_hash(BloomFilter *bf, uint64_t h) {
+    // the second hash comes from the other half of the first
+    uint64_t h2 = ((h << 32 | h >> 32) ^ 0x9e3779b97f4a7c15ULL) | 1;
+    BitVector *bits = bf_scalable(bf) ? bf->chain[bf->slices - 1].bits : bf->filter;
+    uint32_t hashes = bf_scalable(bf) ? bf->chain[bf->slices - 1].hashes : 3;
+    for (uint32_t j = 0; j < hashes; j += 1) {
+        bv_set_bit(bits, (h + j * h2) % bv_length(bits));
+    }
+    return;
+}
+
+// The bf_probe_hash() function checks if an item the caller already
+// hashed is likely to be in the bloom filter
+// Inputs: a pointer to the bloom filter, the 64-bit hash
+// Outputs: true if it is likely to be in the filter
+
+bool bf_probe_hash(BloomFilter *bf, uint64_t h) {
+    uint64_t h2 = ((h << 32 | h >> 32) ^ 0x9e3779b97f4a7c15ULL) | 1;
+    uint32_t slices = __atomic_load_n(&bf->slices, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < (slices ? slices : 1); i += 1) {
+        BitVector *bits = slices ? bf->chain[i].bits : bf->filter;
+        uint32_t hashes = slices ? bf->chain[i].hashes : 3;
+        uint32_t j = 0;
+        while (j < hashes && bv_get_bit(bits, (h + j * h2) % bv_length(bits))) {
+            j += 1;
+        }
+        if (j == hashes) {
+            return true;
+        }
+    }
+    return false;
+}
+
 // The bf_count() function counts the number of set bits in the bloom filter
 // Inputs: a pointer to the bloom filter
 // Outputs: the count of set bits in the bloom filter
 
-uint32_t bf_count(BloomFilter *bf) {
-    uint64_t count = 0;
-    for (uint32_t i = 0; i < bv_length(bf->filter); i += 1) {
-        if (bv_get_bit(bf->filter, i)) {
-            // add to the count only if the bit is set
-            count += 1;
+uint64_t bf_count(BloomFilter *bf) {
+    if (bf_scalable(bf)) {
+        uint64_t count = 0;
+        for (uint32_t i = 0; i < bf->slices; i += 1) {
+            count += bv_count(bf->chain[i].bits);
         }
+        return count;
     }
-    return count;
+    return bv_count(bf->filter);
+}
+
+// The bf_bytes() function finds how much memory the bloom filter uses
+// Inputs: a pointer to the bloom filter
+// Outputs: the size in bytes
+
+uint64_t bf_bytes(BloomFilter *bf) {
+    uint64_t bytes = sizeof(BloomFilter);
+    if (bf_scalable(bf)) {
+        for (uint32_t i = 0; i < bf->slices; i += 1) {
+            bytes += bv_bytes(bf->chain[i].bits);
+        }
+        return bytes;
+    }
+    return bytes + bv_bytes(bf->filter);
+}
+
+// The bf_fp_rate() function estimates the false positive rate from how
+// full the filter is
+// Inputs: a pointer to the bloom filter
+// Outputs: the chance a word not in the filter is probed as in it
+
+double bf_fp_rate(BloomFilter *bf) {
+    if (bf_scalable(bf)) {
+        // a false positive in any slice counts
+        double miss = 1;
+        for (uint32_t i = 0; i < bf->slices; i += 1) {
+            Slice *slice = &bf->chain[i];
+            double load = (double) bv_count(slice->bits) / bv_length(slice->bits);
+            miss *= 1 - pow(load, slice->hashes);
+        }
+        return 1 - miss;
+    }
+    // three bits per word
+    return pow((double) bf_count(bf) / bf_size(bf), 3);
+}
+
+// The bf_target() function gives the false positive rate a scalable filter
+// was made to keep under
+// Inputs: a pointer to the bloom filter
+// Outputs: the target rate, 0 for a fixed size filter
+
+double bf_target(BloomFilter *bf) {
+    return bf_scalable(bf) ? bf->fp : 0;
+}
+
+// The bf_copy() function copies a bloom filter onto a NUMA node, so
+// threads on that node probe local memory
+// Inputs: a pointer to the bloom filter, the node
+// Outputs: a pointer to the copy
+
+BloomFilter *bf_copy(BloomFilter *bf, int node) {
+    BloomFilter *copy = (BloomFilter *) calloc(1, sizeof(BloomFilter));
+    if (copy) {
+        *copy = *bf;
+        copy->generation = salts_generation();
+        pthread_mutex_init(&copy->lock, NULL);
+        bool ok = true;
+        if (bf_scalable(bf)) {
+            for (uint32_t i = 0; i < bf->slices; i += 1) {
+                copy->chain[i].bits = bv_copy(bf->chain[i].bits, node);
+                ok = ok && copy->chain[i].bits;
+            }
+        } else {
+            copy->filter = bv_copy(bf->filter, node);
+            ok = copy->filter != NULL;
+        }
+        if (!ok) {
+            bf_delete(&copy);
+        }
+    }
+    return copy;
+}
+
+// The bf_export() function writes the bloom filter as an image with no
+// pointers in it, so it can be placed anywhere, for a shared segment
+// Inputs: a pointer to the bloom filter, where the image goes (null to
+// only find its size)
+// Outputs: the size of the image in bytes
+
+uint64_t bf_export(BloomFilter *bf, void *to) {
+    char *image = (char *) to;
+    uint32_t slices = __atomic_load_n(&bf->slices, __ATOMIC_ACQUIRE);
+    Image head = { { bf->primary[0], bf->primary[1] }, { bf->secondary[0], bf->secondary[1] },
+        { bf->tertiary[0], bf->tertiary[1] }, bf->fp, slices };
+    if (image) {
+        memcpy(image, &head, sizeof(Image));
+    }
+    uint64_t bytes = sizeof(Image);
+    if (!slices) {
+        return bytes + bv_export(bf->filter, image ? image + bytes : NULL);
+    }
+    for (uint32_t i = 0; i < slices; i += 1) {
+        Part part = { bf->chain[i].hashes, bf->chain[i].capacity, bf->chain[i].inserted };
+        if (image) {
+            memcpy(image + bytes, &part, sizeof(Part));
+        }
+        bytes += sizeof(Part);
+        bytes += bv_export(bf->chain[i].bits, image ? image + bytes : NULL);
+    }
+    return bytes;
+}
+
+// The bf_attach() function makes a read-only bloom filter of an image from
+// bf_export(), probing the bits where they lie. It takes no inserts
+// Inputs: the image, which has to outlive the filter
+// Outputs: a pointer to the bloom filter, or null if memory ran out
+
+BloomFilter *bf_attach(const void *image) {
+    BloomFilter *bf = (BloomFilter *) calloc(1, sizeof(BloomFilter));
+    if (!bf) {
+        return NULL;
+    }
+    const Image *head = (const Image *) image;
+    memcpy(bf->primary, head->primary, sizeof(bf->primary));
+    memcpy(bf->secondary, head->secondary, sizeof(bf->secondary));
+    memcpy(bf->tertiary, head->tertiary, sizeof(bf->tertiary));
+    bf->fp = head->fp;
+    bf->generation = salts_generation();
+    pthread_mutex_init(&bf->lock, NULL);
+    const char *next = (const char *) image + sizeof(Image);
+    bool ok = true;
+    if (!head->slices) {
+        bf->filter = bv_attach(next);
+        ok = bf->filter != NULL;
+    }
+    for (uint32_t i = 0; ok && i < head->slices && i < BF_MAX_SLICES; i += 1) {
+        const Part *part = (const Part *) next;
+        Slice *slice = &bf->chain[i];
+        slice->hashes = (uint32_t) part->hashes;
+        slice->capacity = part->capacity;
+        slice->inserted = part->inserted;
+        slice->bits = bv_attach(next + sizeof(Part));
+        ok = slice->bits != NULL;
+        next += sizeof(Part) + (ok ? sizeof(uint64_t) + bv_bytes(slice->bits) : 0);
+        bf->slices = ok ? i + 1 : i;
+    }
+    if (!ok) {
+        bf_delete(&bf);
+    }
+    return bf;
+}
+
+// The bf_page_size() function finds the page size the filter got
+// Inputs: a pointer to the bloom filter
+// Outputs: the page size in bytes
+
+size_t bf_page_size(BloomFilter *bf) {
+    return bv_page_size(bf_scalable(bf) ? bf->chain[bf->slices - 1].bits : bf->filter);
 }
 
 // The bf_print() function prints out the bit vector in the bloom filter
@@ -124,5 +500,11 @@ uint32_t bf_count(BloomFilter *bf) {
 // Outputs: void
 
 void bf_print(BloomFilter *bf) {
+    if (bf_scalable(bf)) {
+        for (uint32_t i = 0; i < bf->slices; i += 1) {
+            bv_print(bf->chain[i].bits);
+        }
+        return;
+    }
     bv_print(bf->filter);
 }
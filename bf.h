@@ -7,16 +7,42 @@
 
 typedef struct BloomFilter BloomFilter;
 
-BloomFilter *bf_create(uint32_t size);
+BloomFilter *bf_create(uint64_t size);
+
+BloomFilter *bf_create_scalable(double fp);
+
+bool bf_scalable(BloomFilter *bf);
 
 void bf_delete(BloomFilter **bf);
 
-uint32_t bf_size(BloomFilter *bf);
+void bf_publish(BloomFilter *bf);
+
+uint64_t bf_generation(BloomFilter *bf);
+
+uint64_t bf_size(BloomFilter *bf);
 
 void bf_insert(BloomFilter *bf, char *oldspeak);
 
 bool bf_probe(BloomFilter *bf, char *oldspeak);
 
-uint32_t bf_count(BloomFilter *bf);
+void bf_insert_hash(BloomFilter *bf, uint64_t h);
+
+bool bf_probe_hash(BloomFilter *bf, uint64_t h);
+
+uint64_t bf_count(BloomFilter *bf);
+
+uint64_t bf_bytes(BloomFilter *bf);
+
+double bf_fp_rate(BloomFilter *bf);
+
+double bf_target(BloomFilter *bf);
+
+BloomFilter *bf_copy(BloomFilter *bf, int node);
+
+uint64_t bf_export(BloomFilter *bf, void *to);
+
+BloomFilter *bf_attach(const void *image);
+
+size_t bf_page_size(BloomFilter *bf);
 
 void bf_print(BloomFilter *bf);
@@ -8,8 +8,8 @@
 #include <stdlib.h>
 
 // branches counts the number of links traversed while finding
-// and inserting with BST
-uint64_t branches;
+// and inserting with BST, each thread keeps its own count
+_Thread_local uint64_t branches;
 
 // The bst_create() function contructs a binary search tree
 // Inputs: void
@@ -38,11 +38,9 @@ void bst_delete(Node **root) {
 
 uint32_t bst_height(Node *root) {
     if (root) {
-        if (bst_height(root->left) > bst_height(root->right)) {
-            return bst_height(root->left) + 1; // add 1 for root itself·
-        } else {
-            return bst_height(root->right) + 1; // add 1 for root itself
-        }
+        uint32_t left = bst_height(root->left);
+        uint32_t right = bst_height(root->right);
+        return (left > right ? left : right) + 1; // add 1 for root itself
     } else {
         return 0; // root is null
     }
@@ -61,48 +59,109 @@ uint32_t bst_size(Node *root) {
     }
 }
 
+// The bst_bytes() function finds how much memory a tree uses
+// Inputs: a pointer to a root node
+// Outputs: the size of the nodes and the words they hold, in bytes
+
+uint64_t bst_bytes(Node *root) {
+    if (root) {
+        uint64_t bytes = sizeof(Node);
+        if (root->oldspeak && root->oldspeak != root->key) {
+            bytes += root->length + 1; // long words are allocated separately
+        }
+        if (root->newspeak) {
+            bytes += strlen(root->newspeak) + 1;
+        }
+        return bytes + bst_bytes(root->left) + bst_bytes(root->right);
+    } else {
+        return 0;
+    }
+}
+
 // The bst_find() finds the root containing the given oldspeak
 // in the binary search tree
 // Inputs: a pointer to a root node, oldspeak that we finding
 // Outputs: node containing the given oldspeak
 
 Node *bst_find(Node *root, char *oldspeak) {
-    if (root) {
-        if (strcmp(root->oldspeak, oldspeak) > 0) {
+    uint32_t length = (uint32_t) strlen(oldspeak);
+    uint64_t prefix = node_prefix(oldspeak, length);
+    while (root) {
+        // one comparison per level decides which way to go
+        int diff = node_compare(root, prefix, oldspeak, length);
+        if (diff > 0) {
             // the string is larger, look to the left
             branches += 1;
-            return bst_find(root->left, oldspeak);
-        } else if (strcmp(root->oldspeak, oldspeak) < 0) {
+            root = __atomic_load_n(&root->left, __ATOMIC_ACQUIRE);
+        } else if (diff < 0) {
             // the string is smaller, look to the right
             branches += 1;
-            return bst_find(root->right, oldspeak);
+            root = __atomic_load_n(&root->right, __ATOMIC_ACQUIRE);
+        } else {
+            break;
         }
     }
-    return root; // returns root if null, and itself if root->oldspeak == oldspeak
+    return root; // returns null if not found, and the node if root->oldspeak == oldspeak
 }
 
-// The bst_insert() function inserts a given oldspeak and newspeak
-// to the binary search tree
-// Inputs: a pointer to a root node, oldspeak and newspeak
-// Outputs: the node that was inserted into
+// The bst_insert_at() function inserts a given oldspeak and newspeak
+// below a link (a root or child pointer). Nodes are never moved once
+// linked in, so a new node is published with one compare-and-swap on an
+// empty link: threads can insert at the same time as each other and as
+// bst_find() without any lock
+// Inputs: the link to start at, oldspeak and newspeak
+// Outputs: the node holding the oldspeak, or null if memory ran out
 
-Node *bst_insert(Node *root, char *oldspeak, char *newspeak) {
-    if (root && oldspeak) {
-        if (strcmp(root->oldspeak, oldspeak) > 0) {
+Node *bst_insert_at(Node **link, char *oldspeak, char *newspeak) {
+    if (oldspeak == NULL) {
+        return NULL;
+    }
+    uint32_t length = (uint32_t) strlen(oldspeak);
+    uint64_t prefix = node_prefix(oldspeak, length);
+    Node *fresh = NULL;
+    while (true) {
+        Node *n = __atomic_load_n(link, __ATOMIC_ACQUIRE);
+        if (!n) {
+            if (!fresh && !(fresh = node_create(oldspeak, newspeak))) {
+                return NULL;
+            }
+            // the node's contents are visible before the link is
+            if (__atomic_compare_exchange_n(
+                    link, &n, fresh, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+                return fresh;
+            }
+            // another thread linked a node here first, compare against it
+        }
+        int diff = node_compare(n, prefix, oldspeak, length);
+        if (diff > 0) {
             // string is larger so go left
             branches += 1; // going down a branch, so add 1
-            root->left = bst_insert(root->left, oldspeak, newspeak);
-        } else if (strcmp(root->oldspeak, oldspeak) < 0) {
+            link = &n->left;
+        } else if (diff < 0) {
             // string is larger so go right
             branches += 1; // going down a branch, so add 1
-            root->right = bst_insert(root->right, oldspeak, newspeak);
+            link = &n->right;
+        } else {
+            // already in the tree
+            if (fresh) {
+                node_delete(&fresh);
+            }
+            return n;
         }
-        return root;
-    } else if (oldspeak == NULL) {
+    }
+}
+
+// The bst_insert() function inserts a given oldspeak and newspeak
+// to the binary search tree
+// Inputs: a pointer to a root node, oldspeak and newspeak
+// Outputs: the node that was inserted into
+
+Node *bst_insert(Node *root, char *oldspeak, char *newspeak) {
+    if (oldspeak == NULL) {
         return NULL;
-    } else {
-        return node_create(oldspeak, newspeak);
     }
+    bst_insert_at(&root, oldspeak, newspeak);
+    return root;
 }
 
 // The bst_print() function prints out the binary search tree
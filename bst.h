@@ -4,7 +4,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-extern uint64_t branches;
+extern _Thread_local uint64_t branches;
 
 Node *bst_create(void);
 
@@ -12,8 +12,12 @@ uint32_t bst_height(Node *root);
 
 uint32_t bst_size(Node *root);
 
+uint64_t bst_bytes(Node *root);
+
 Node *bst_find(Node *root, char *oldspeak);
 
+Node *bst_insert_at(Node **link, char *oldspeak, char *newspeak);
+
 Node *bst_insert(Node *root, char *oldspeak, char *newspeak);
 
 void bst_print(Node *root);
@@ -2,32 +2,120 @@
 // I also used code.c from my assignment 5 for all
 // of the functions
 #include "bv.h"
+#include "mem.h"
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 // Structure for Bit Vector
 // length = length of bit vector
-// vector = the array containing the bit vector
+// vector = the array containing the bit vector, 64 bits per word
+// page = size of the pages the vector got
+// borrowed = the vector is someone else's memory (a shared segment), read
+// only and not freed here
 
 struct BitVector {
-    uint32_t length;
-    uint8_t *vector;
+    uint64_t length;
+    uint64_t *vector;
+    size_t page;
+    bool borrowed;
 };
 
+// The bv_words() function finds how many words hold the bits
+// Inputs: the length of the bit vector
+// Outputs: the number of 64 bit words
+
+static inline uint64_t bv_words(uint64_t length) {
+    return length / 64 + (length % 64 != 0);
+}
+
 // The bv_create() function creates a bit vector
 // Inputs: the length of the bit vector
 // Outputs: a pointer to the bit vector
 
-BitVector *bv_create(uint32_t length) {
+BitVector *bv_create(uint64_t length) {
+    return bv_create_on(length, -1);
+}
+
+// The bv_create_on() function creates a bit vector on a NUMA node
+// Inputs: the length of the bit vector, the node (-1 for any)
+// Outputs: a pointer to the bit vector
+
+BitVector *bv_create_on(uint64_t length, int node) {
     BitVector *bv = (BitVector *) calloc(1, sizeof(BitVector));
     if (bv) {
-        // set the length and make the vector
+        // set the length and make the vector, big ones get huge pages
         bv->length = length;
-        bv->vector = (uint8_t *) calloc(length, sizeof(uint8_t));
+        bv->vector = (uint64_t *) mem_alloc(bv_bytes(bv), node, &bv->page);
+        if (!bv->vector) {
+            free(bv);
+            bv = NULL;
+        }
     }
     return bv;
 }
 
+// The bv_copy() function copies a bit vector onto a NUMA node
+// Inputs: a pointer to the bit vector, the node
+// Outputs: a pointer to the copy
+
+BitVector *bv_copy(BitVector *bv, int node) {
+    BitVector *copy = bv_create_on(bv->length, node);
+    if (copy) {
+        memcpy(copy->vector, bv->vector, bv_bytes(bv));
+    }
+    return copy;
+}
+
+// The bv_export() function writes the bit vector as an image, its length
+// then its words, that bv_attach() can use where it lies
+// Inputs: a pointer to the bit vector, where the image goes (null to only
+// find its size)
+// Outputs: the size of the image in bytes
+
+uint64_t bv_export(BitVector *bv, void *to) {
+    if (to) {
+        memcpy(to, &bv->length, sizeof(uint64_t));
+        memcpy((uint64_t *) to + 1, bv->vector, bv_bytes(bv));
+    }
+    return sizeof(uint64_t) + bv_bytes(bv);
+}
+
+// The bv_attach() function makes a read-only bit vector of an image from
+// bv_export(), the bits stay where they are
+// Inputs: the image, which has to outlive the bit vector
+// Outputs: a pointer to the bit vector, or null if memory ran out
+
+BitVector *bv_attach(const void *image) {
+    BitVector *bv = (BitVector *) calloc(1, sizeof(BitVector));
+    if (bv) {
+        bv->length = *(const uint64_t *) image;
+        bv->vector = (uint64_t *) image + 1;
+        long page = sysconf(_SC_PAGESIZE);
+        bv->page = page > 0 ? (size_t) page : 4096;
+        bv->borrowed = true;
+    }
+    return bv;
+}
+
+// The bv_page_size() function finds the page size the vector got
+// Inputs: a pointer to the bit vector
+// Outputs: the page size in bytes
+
+size_t bv_page_size(BitVector *bv) {
+    return mem_page_size(bv->vector, bv_bytes(bv), bv->page);
+}
+
+// The bv_bytes() function finds how much memory the bits take
+// Inputs: a pointer to the bit vector
+// Outputs: the size of the vector in bytes
+
+uint64_t bv_bytes(BitVector *bv) {
+    return bv_words(bv->length) * sizeof(uint64_t);
+}
+
 // The bv_print() function prints each bit in the bit vector
 // Inputs: a pointer to the bit vector
 // Outputs: void
@@ -39,13 +127,27 @@ void bv_print(BitVector *bv) {
     return;
 }
 
+// The bv_count() function counts the set bits, a word at a time
+// Inputs: a pointer to the bit vector
+// Outputs: the number of set bits
+
+uint64_t bv_count(BitVector *bv) {
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < bv_words(bv->length); i += 1) {
+        count += (uint64_t) __builtin_popcountll(bv->vector[i]);
+    }
+    return count;
+}
+
 // The bv_delete() function destructs the bit vector
 // Inputs: a pointer to a pointer to the bit vector
 // Outputs: void
 
 void bv_delete(BitVector **bv) {
     if (*bv) {
-        free((*bv)->vector);
+        if (!(*bv)->borrowed) {
+            mem_free((*bv)->vector, bv_bytes(*bv), (*bv)->page);
+        }
         free(*bv);
         *bv = NULL;
     }
@@ -56,7 +158,7 @@ void bv_delete(BitVector **bv) {
 // Inputs: a pointer to the bit vector
 // Outputs: the length of the bit vector
 
-uint32_t bv_length(BitVector *bv) {
+uint64_t bv_length(BitVector *bv) {
     return bv->length;
 }
 
@@ -64,9 +166,10 @@ uint32_t bv_length(BitVector *bv) {
 // Inputs: a pointer to the bit vector, index number
 // Outputs: true or false depending on if setting was successful
 
-bool bv_set_bit(BitVector *bv, uint32_t i) {
+bool bv_set_bit(BitVector *bv, uint64_t i) {
     if (bv && (i < bv->length)) {
-        bv->vector[i / 8] |= (0x1 << i % 8);
+        // atomic, so threads can set bits while others read them
+        __atomic_fetch_or(&bv->vector[i / 64], (uint64_t) 0x1 << i % 64, __ATOMIC_RELAXED);
         return true;
     } else {
         return false;
@@ -77,9 +180,9 @@ bool bv_set_bit(BitVector *bv, uint32_t i) {
 // Inputs: a pointer to the bit vector, index number
 // Outputs: true or false depending on if clearing was successful
 
-bool bv_clr_bit(BitVector *bv, uint32_t i) {
+bool bv_clr_bit(BitVector *bv, uint64_t i) {
     if (bv && (i < bv->length)) {
-        bv->vector[i / 8] &= ~((uint8_t) 0x1 << i % 8);
+        __atomic_fetch_and(&bv->vector[i / 64], ~((uint64_t) 0x1 << i % 64), __ATOMIC_RELAXED);
         return true;
     } else {
         return false;
@@ -92,9 +195,9 @@ bool bv_clr_bit(BitVector *bv, uint32_t i) {
 // Outputs: true or false depending on if the bit was 1 or 0
 // at that given index
 
-bool bv_get_bit(BitVector *bv, uint32_t i) {
+bool bv_get_bit(BitVector *bv, uint64_t i) {
     if (bv && (i < bv->length)) {
-        return ((bv->vector[i / 8] >> i % 8) & 0x1);
+        return ((__atomic_load_n(&bv->vector[i / 64], __ATOMIC_RELAXED) >> i % 64) & 0x1);
     } else {
         return false;
     }
@@ -1,20 +1,36 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct BitVector BitVector;
 
-BitVector *bv_create(uint32_t length);
+BitVector *bv_create(uint64_t length);
+
+BitVector *bv_create_on(uint64_t length, int node);
+
+BitVector *bv_copy(BitVector *bv, int node);
+
+uint64_t bv_export(BitVector *bv, void *to);
+
+BitVector *bv_attach(const void *image);
+
+size_t bv_page_size(BitVector *bv);
+
+uint64_t bv_bytes(BitVector *bv);
 
 void bv_delete(BitVector **bv);
 
-uint32_t bv_length(BitVector *bv);
+uint64_t bv_length(BitVector *bv);
+
+bool bv_set_bit(BitVector *bv, uint64_t i);
+
+bool bv_clr_bit(BitVector *bv, uint64_t i);
 
-bool bv_set_bit(BitVector *bv, uint32_t i);
+bool bv_get_bit(BitVector *bv, uint64_t i);
 
-bool bv_clr_bit(BitVector *bv, uint32_t i);
+uint64_t bv_count(BitVector *bv);
 
-bool bv_get_bit(BitVector *bv, uint32_t i);
 
 void bv_print(BitVector *bv);
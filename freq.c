@@ -0,0 +1,261 @@
+// Bounded-memory statistics on which dictionary words are hit and how
+// often. Every hit goes into a Count-Min sketch (counts that can only be
+// too high, by at most e / FREQ_WIDTH of all hits with probability
+// 1 - e^-FREQ_DEPTH), a Space-Saving list of the words hit most, and a
+// HyperLogLog estimate of how many different words were hit. All memory
+// is allocated up front and hits never allocate. Threads update the
+// stripe for the CPU they run on, each with its own lock, and the
+// stripes are merged when the numbers are read.
+#define _GNU_SOURCE
+#include "freq.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Count-Min sketch size, and HyperLogLog registers (2^FREQ_BITS)
+#define FREQ_WIDTH 2048
+#define FREQ_DEPTH 4
+#define FREQ_BITS  12
+
+// Structure for a word on the Space-Saving list
+// word = the dictionary node that was hit
+// count = hits counted for it, never too low
+
+typedef struct {
+    Node *word;
+    uint64_t count;
+} Heavy;
+
+// Structure for one stripe of the statistics
+// lock = held while the stripe is updated
+// total = hits counted in this stripe
+// sketch = Count-Min counters, FREQ_DEPTH rows of FREQ_WIDTH
+// heavy = the Space-Saving list, used entries of it filled
+// registers = HyperLogLog registers
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t total;
+    uint32_t sketch[FREQ_DEPTH][FREQ_WIDTH];
+    Heavy heavy[FREQ_TRACK];
+    uint32_t used;
+    uint8_t registers[1 << FREQ_BITS];
+} Stripe;
+
+// Structure for Freq
+// stripes = one per CPU, count of them
+
+struct Freq {
+    Stripe *stripes;
+    uint32_t count;
+};
+
+// The freq_create() function makes empty statistics
+// Inputs: how many stripes (one per CPU is best)
+// Outputs: a pointer to the statistics, or null if memory ran out
+
+Freq *freq_create(uint32_t stripes) {
+    Freq *f = (Freq *) calloc(1, sizeof(Freq));
+    if (f) {
+        f->count = stripes ? stripes : 1;
+        f->stripes = (Stripe *) calloc(f->count, sizeof(Stripe));
+        if (!f->stripes) {
+            free(f);
+            return NULL;
+        }
+        for (uint32_t i = 0; i < f->count; i += 1) {
+            pthread_mutex_init(&f->stripes[i].lock, NULL);
+        }
+    }
+    return f;
+}
+
+// The freq_delete() function frees the statistics
+// Inputs: a pointer to the pointer to the statistics
+// Outputs: void
+
+void freq_delete(Freq **f) {
+    if (*f) {
+        for (uint32_t i = 0; i < (*f)->count; i += 1) {
+            pthread_mutex_destroy(&(*f)->stripes[i].lock);
+        }
+        free((*f)->stripes);
+        free(*f);
+        *f = NULL;
+    }
+    return;
+}
+
+// The freq_hash() function hashes a word (FNV-1a, then mixed)
+// Inputs: the word and its length
+// Outputs: the 64-bit hash
+
+static uint64_t freq_hash(const char *word, uint32_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (uint32_t i = 0; i < length; i += 1) {
+        h ^= (uint8_t) word[i];
+        h *= 0x100000001b3ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// The column() function picks a word's counter in one row of the sketch
+// Inputs: the word's hash, the row
+// Outputs: the column
+
+static inline uint32_t column(uint64_t h, uint32_t row) {
+    uint64_t h2 = (h >> 32 | h << 32) | 1;
+    return (uint32_t) ((h + row * h2) % FREQ_WIDTH);
+}
+
+// The freq_add() function counts one hit on a dictionary word
+// Inputs: the statistics, the node that was hit
+// Outputs: void
+
+void freq_add(Freq *f, Node *n) {
+    uint64_t h = freq_hash(n->oldspeak, n->length);
+    int cpu = sched_getcpu();
+    Stripe *s = &f->stripes[(uint32_t) (cpu > 0 ? cpu : 0) % f->count];
+    pthread_mutex_lock(&s->lock);
+    s->total += 1;
+    for (uint32_t row = 0; row < FREQ_DEPTH; row += 1) {
+        s->sketch[row][column(h, row)] += 1;
+    }
+    // HyperLogLog: the top bits pick a register, it keeps the longest
+    // run of leading zeros seen in the rest
+    uint64_t rest = h << FREQ_BITS;
+    uint8_t rank = rest ? (uint8_t) (__builtin_clzll(rest) + 1) : 64 - FREQ_BITS + 1;
+    uint8_t *reg = &s->registers[h >> (64 - FREQ_BITS)];
+    *reg = rank > *reg ? rank : *reg;
+    // Space-Saving: a new word takes over the smallest count
+    uint32_t smallest = 0;
+    for (uint32_t i = 0; i < s->used; i += 1) {
+        if (s->heavy[i].word == n) {
+            s->heavy[i].count += 1;
+            pthread_mutex_unlock(&s->lock);
+            return;
+        }
+        smallest = s->heavy[i].count < s->heavy[smallest].count ? i : smallest;
+    }
+    if (s->used < FREQ_TRACK) {
+        s->heavy[s->used++] = (Heavy) { n, 1 };
+    } else {
+        s->heavy[smallest] = (Heavy) { n, s->heavy[smallest].count + 1 };
+    }
+    pthread_mutex_unlock(&s->lock);
+    return;
+}
+
+// The freq_total() function counts all hits
+// Inputs: the statistics
+// Outputs: the number of hits
+
+uint64_t freq_total(Freq *f) {
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < f->count; i += 1) {
+        total += f->stripes[i].total;
+    }
+    return total;
+}
+
+// The freq_distinct() function estimates how many different words were
+// hit, the stripes' registers merge by taking the largest
+// Inputs: the statistics
+// Outputs: the estimate
+
+uint64_t freq_distinct(Freq *f) {
+    const uint32_t m = 1 << FREQ_BITS;
+    double sum = 0;
+    uint32_t zeros = 0;
+    for (uint32_t j = 0; j < m; j += 1) {
+        uint8_t reg = 0;
+        for (uint32_t i = 0; i < f->count; i += 1) {
+            reg = f->stripes[i].registers[j] > reg ? f->stripes[i].registers[j] : reg;
+        }
+        sum += ldexp(1.0, -reg);
+        zeros += reg == 0;
+    }
+    double alpha = 0.7213 / (1 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    if (estimate <= 2.5 * m && zeros) {
+        // few words, counting empty registers is more accurate
+        estimate = m * log((double) m / zeros);
+    }
+    return (uint64_t) llround(estimate);
+}
+
+// The freq_error() function finds how much a count may be too high
+// Inputs: the statistics
+// Outputs: the bound, e / FREQ_WIDTH of all hits
+
+uint64_t freq_error(Freq *f) {
+    return (uint64_t) ceil(exp(1.0) / FREQ_WIDTH * (double) freq_total(f));
+}
+
+// The estimate() function reads a word's count from the merged sketch
+// Inputs: the statistics, the word
+// Outputs: the count, never too low
+
+static uint64_t estimate(Freq *f, Node *n) {
+    uint64_t h = freq_hash(n->oldspeak, n->length);
+    uint64_t best = UINT64_MAX;
+    for (uint32_t row = 0; row < FREQ_DEPTH; row += 1) {
+        uint64_t sum = 0;
+        for (uint32_t i = 0; i < f->count; i += 1) {
+            sum += f->stripes[i].sketch[row][column(h, row)];
+        }
+        best = sum < best ? sum : best;
+    }
+    return best;
+}
+
+// The freq_top() function finds the words hit most. Every word on a
+// stripe's Space-Saving list is a candidate, ranked by the merged sketch
+// Inputs: the statistics, where the words and counts go, how many at most
+// Outputs: how many were found
+
+uint32_t freq_top(Freq *f, Node **words, uint64_t *counts, uint32_t k) {
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < f->count; i += 1) {
+        for (uint32_t j = 0; j < f->stripes[i].used; j += 1) {
+            Node *n = f->stripes[i].heavy[j].word;
+            uint64_t count = estimate(f, n);
+            uint32_t at = 0;
+            while (at < found && words[at] != n) {
+                at += 1;
+            }
+            if (at < found) {
+                continue; // already a candidate
+            }
+            // insertion into the list, largest first
+            at = found < k ? found : k;
+            while (at > 0 && counts[at - 1] < count) {
+                if (at < k) {
+                    words[at] = words[at - 1];
+                    counts[at] = counts[at - 1];
+                }
+                at -= 1;
+            }
+            if (at < k) {
+                words[at] = n;
+                counts[at] = count;
+                found += found < k;
+            }
+        }
+    }
+    return found;
+}
+
+// The freq_bytes() function finds how much memory the statistics use
+// Inputs: the statistics
+// Outputs: the number of bytes
+
+uint64_t freq_bytes(Freq *f) {
+    return sizeof(Freq) + (uint64_t) f->count * sizeof(Stripe);
+}
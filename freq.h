@@ -0,0 +1,27 @@
+#pragma once
+
+#include "node.h"
+
+#include <stdint.h>
+
+// Words the top list can hold per stripe, and how many are reported
+#define FREQ_TRACK 32
+#define FREQ_TOP   10
+
+typedef struct Freq Freq;
+
+Freq *freq_create(uint32_t stripes);
+
+void freq_delete(Freq **f);
+
+void freq_add(Freq *f, Node *n);
+
+uint64_t freq_total(Freq *f);
+
+uint64_t freq_distinct(Freq *f);
+
+uint64_t freq_error(Freq *f);
+
+uint32_t freq_top(Freq *f, Node **words, uint64_t *counts, uint32_t k);
+
+uint64_t freq_bytes(Freq *f);
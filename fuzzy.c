@@ -0,0 +1,294 @@
+// Fuzzy matching for words disguised with look-alike characters or a
+// single typo. Words are first folded through a character map (4 -> a,
+// 0 -> o, ...). Every dictionary word is then indexed under itself and
+// under each way of deleting one of its characters, so a word within one
+// edit of a dictionary word shares at least one of those strings with it
+// (SymSpell). A lookup hashes the word and its own deletions, about one
+// probe per character, and checks the few candidates it finds.
+#include "fuzzy.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Structure for one slot of the deletion index
+// hash = hash of the word with a character deleted (or none)
+// word = index of the dictionary word plus one, 0 for an empty slot
+
+typedef struct {
+    uint64_t hash;
+    uint32_t word;
+} Slot;
+
+// Structure for the fuzzy index
+// map = what each byte is folded to
+// chars = the bytes the map folds, so the tokenizer can keep them
+// words = the folded dictionary words, with their newspeak
+// count, capacity = how many words there are and room for
+// slots = the deletion index, open addressing, size a power of 2
+// size, used = number of slots and how many are taken
+
+struct Fuzzy {
+    char map[256];
+    char chars[128];
+    Node **words;
+    uint32_t count;
+    uint32_t capacity;
+    Slot *slots;
+    uint64_t size;
+    uint64_t used;
+};
+
+// The fuzzy_create() function makes an empty fuzzy index
+// Inputs: the character map, pairs of from and to characters
+// Outputs: a pointer to the index, or null if memory ran out
+
+Fuzzy *fuzzy_create(const char *map) {
+    Fuzzy *f = (Fuzzy *) calloc(1, sizeof(Fuzzy));
+    if (!f) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < 256; i += 1) {
+        f->map[i] = (char) i;
+    }
+    uint32_t used = 0;
+    for (size_t i = 0; map[i] && map[i + 1]; i += 2) {
+        f->map[(uint8_t) map[i]] = map[i + 1];
+        if (used + 1 < sizeof(f->chars)) {
+            f->chars[used++] = map[i];
+        }
+    }
+    f->size = 1024;
+    f->slots = (Slot *) calloc(f->size, sizeof(Slot));
+    if (!f->slots) {
+        free(f);
+        return NULL;
+    }
+    return f;
+}
+
+// The fuzzy_delete() function frees the fuzzy index
+// Inputs: a pointer to the pointer to the index
+// Outputs: void
+
+void fuzzy_delete(Fuzzy **f) {
+    if (*f) {
+        for (uint32_t i = 0; i < (*f)->count; i += 1) {
+            node_delete(&(*f)->words[i]);
+        }
+        free((*f)->words);
+        free((*f)->slots);
+        free(*f);
+        *f = NULL;
+    }
+    return;
+}
+
+// The fold() function copies a word through the character map
+// Inputs: the index, the word, where to copy it (FUZZY_LONGEST + 1 bytes)
+// Outputs: the length, or 0 if the word is too long
+
+static size_t fold(Fuzzy *f, const char *word, char *out) {
+    size_t length = 0;
+    for (; word[length]; length += 1) {
+        if (length == FUZZY_LONGEST) {
+            return 0;
+        }
+        out[length] = f->map[(uint8_t) word[length]];
+    }
+    out[length] = '\0';
+    return length;
+}
+
+// The variant_hash() function hashes a word with one character left out
+// (FNV-1a, then mixed)
+// Inputs: the word, its length, the character to leave out (length for
+// none)
+// Outputs: the 64-bit hash
+
+static uint64_t variant_hash(const char *word, size_t length, size_t skip) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i += 1) {
+        if (i != skip) {
+            h ^= (uint8_t) word[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// The grow() function doubles the number of slots
+// Inputs: the index
+// Outputs: false if memory ran out
+
+static bool grow(Fuzzy *f) {
+    uint64_t size = 2 * f->size;
+    Slot *slots = (Slot *) calloc(size, sizeof(Slot));
+    if (!slots) {
+        return false;
+    }
+    for (uint64_t i = 0; i < f->size; i += 1) {
+        if (f->slots[i].word) {
+            uint64_t j = f->slots[i].hash & (size - 1);
+            while (slots[j].word) {
+                j = (j + 1) & (size - 1);
+            }
+            slots[j] = f->slots[i];
+        }
+    }
+    free(f->slots);
+    f->slots = slots;
+    f->size = size;
+    return true;
+}
+
+// The add() function puts one variant of a word in the index
+// Inputs: the index, the variant's hash, the word's index plus one
+// Outputs: false if memory ran out
+
+static bool add(Fuzzy *f, uint64_t hash, uint32_t word) {
+    if (2 * (f->used + 1) > f->size && !grow(f)) {
+        return false;
+    }
+    uint64_t j = hash & (f->size - 1);
+    while (f->slots[j].word) {
+        j = (j + 1) & (f->size - 1);
+    }
+    f->slots[j].hash = hash;
+    f->slots[j].word = word;
+    f->used += 1;
+    return true;
+}
+
+// The fuzzy_insert() function adds a dictionary word to the index
+// Inputs: the index, the oldspeak and its newspeak (may be null), the
+// categories it is listed in
+// Outputs: false if memory ran out
+
+bool fuzzy_insert(Fuzzy *f, char *oldspeak, char *newspeak, Set categories) {
+    char folded[FUZZY_LONGEST + 1];
+    size_t length = fold(f, oldspeak, folded);
+    if (!length) {
+        return true; // too long to ever match
+    }
+    if (f->count == f->capacity) {
+        uint32_t capacity = f->capacity ? 2 * f->capacity : 1024;
+        Node **words = (Node **) realloc(f->words, capacity * sizeof(Node *));
+        if (!words) {
+            return false;
+        }
+        f->words = words;
+        f->capacity = capacity;
+    }
+    Node *n = node_create(folded, newspeak);
+    if (!n) {
+        return false;
+    }
+    n->categories = categories;
+    f->words[f->count++] = n;
+    bool ok = add(f, variant_hash(folded, length, length), f->count);
+    for (size_t i = 0; ok && length >= FUZZY_MIN && i < length; i += 1) {
+        ok = add(f, variant_hash(folded, length, i), f->count);
+    }
+    return ok;
+}
+
+// The within_one() function checks if two words are at most one edit
+// apart, counting swapped neighbours as one edit
+// Inputs: the two words and their lengths
+// Outputs: true if they are
+
+static bool within_one(const char *a, size_t la, const char *b, size_t lb) {
+    if (la > lb) {
+        return within_one(b, lb, a, la);
+    }
+    if (lb - la > 1) {
+        return false;
+    }
+    size_t i = 0;
+    while (i < la && a[i] == b[i]) {
+        i += 1;
+    }
+    if (la < lb) {
+        // one character was added
+        return !strcmp(a + i, b + i + 1);
+    }
+    if (i >= la - 1) {
+        return true;
+    }
+    if (a[i] == b[i + 1] && a[i + 1] == b[i] && !strcmp(a + i + 2, b + i + 2)) {
+        return true;
+    }
+    return !strcmp(a + i + 1, b + i + 1);
+}
+
+// The fuzzy_lookup() function finds a dictionary word within one edit of
+// a word, after folding both through the character map
+// Inputs: the index, the word, a counter for the index probes
+// Outputs: the matching node, or null if there is none
+
+Node *fuzzy_lookup(Fuzzy *f, const char *word, uint64_t *probes) {
+    char folded[FUZZY_LONGEST + 1];
+    size_t length = fold(f, word, folded);
+    if (!length) {
+        return NULL;
+    }
+    // the whole word first, then each deletion, an exact match wins over
+    // the first near one
+    Node *near = NULL;
+    size_t last = length >= FUZZY_MIN ? 0 : length;
+    for (size_t skip = length + 1; skip-- > last;) {
+        uint64_t hash = variant_hash(folded, length, skip);
+        *probes += 1;
+        for (uint64_t j = hash & (f->size - 1); f->slots[j].word; j = (j + 1) & (f->size - 1)) {
+            Node *n = f->words[f->slots[j].word - 1];
+            if (f->slots[j].hash != hash) {
+                continue;
+            }
+            if (n->length == length && !strcmp(folded, n->oldspeak)) {
+                return n;
+            }
+            if (!near && n->length >= FUZZY_MIN && length >= FUZZY_MIN
+                && within_one(folded, length, n->oldspeak, n->length)) {
+                near = n;
+            }
+        }
+    }
+    return near;
+}
+
+// The fuzzy_chars() function gives the characters the map folds
+// Inputs: the index
+// Outputs: the characters, as a string
+
+const char *fuzzy_chars(Fuzzy *f) {
+    return f->chars;
+}
+
+// The fuzzy_count() function counts the words in the index
+// Inputs: the index
+// Outputs: the number of words
+
+uint64_t fuzzy_count(Fuzzy *f) {
+    return f->count;
+}
+
+// The fuzzy_bytes() function finds how much memory the index uses
+// Inputs: the index
+// Outputs: the number of bytes
+
+uint64_t fuzzy_bytes(Fuzzy *f) {
+    uint64_t bytes = sizeof(Fuzzy) + f->capacity * sizeof(Node *) + f->size * sizeof(Slot);
+    for (uint32_t i = 0; i < f->count; i += 1) {
+        bytes += sizeof(Node);
+        if (f->words[i]->oldspeak != f->words[i]->key) {
+            bytes += f->words[i]->length + 1;
+        }
+        if (f->words[i]->newspeak) {
+            bytes += strlen(f->words[i]->newspeak) + 1;
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "node.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Shortest word that may match with one edit, shorter words are too
+// easy to turn into one another
+#define FUZZY_MIN 5
+
+// Longest word checked for fuzzy matches
+#define FUZZY_LONGEST 64
+
+// Look-alike characters folded before matching, as from/to pairs
+#define FUZZY_MAP "4a@a3e1i!i0o5s$s7t"
+
+typedef struct Fuzzy Fuzzy;
+
+Fuzzy *fuzzy_create(const char *map);
+
+void fuzzy_delete(Fuzzy **f);
+
+bool fuzzy_insert(Fuzzy *f, char *oldspeak, char *newspeak, Set categories);
+
+Node *fuzzy_lookup(Fuzzy *f, const char *word, uint64_t *probes);
+
+const char *fuzzy_chars(Fuzzy *f);
+
+uint64_t fuzzy_count(Fuzzy *f);
+
+uint64_t fuzzy_bytes(Fuzzy *f);
@@ -4,42 +4,106 @@
 #include "ht.h"
 #include "node.h"
 #include "bst.h"
+#include "mem.h"
 #include "salts.h"
 #include "speck.h"
 
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 // lookups counts the number of times lookups and insert is called for
-// a hash table
-uint64_t lookups;
+// a hash table, each thread keeps its own count
+_Thread_local uint64_t lookups;
 
 // Stucture for a Hash Table
 // salt = salt array for the hash table
 // size = size of the hash table
 // trees = array of nodes
+// page = size of the pages the trees got
+// frozen = after ht_freeze(), every node and the words they point at in
+// one allocation, each tree an array in Eytzinger order that trees[i]
+// points at, null before
+// counts = number of nodes in each frozen tree
+// frozen_bytes, frozen_page = size of the frozen allocation and its pages
+// generation = unique to this table, drawn again when the nodes move and
+// on every insert
+// rehashes = how many times fresh salts were drawn because a tree got too
+// deep
+// image = the table image from a shared segment, when attached, null
+// otherwise (trees is null then)
+// shells = for an attached table, a node for each image word that has been
+// found, made on first use, by index
 
 struct HashTable {
     uint64_t salt[2];
-    uint32_t size;
+    uint64_t size;
     Node **trees;
+    size_t page;
+    Node *frozen;
+    uint32_t *counts;
+    size_t frozen_bytes;
+    size_t frozen_page;
+    uint64_t generation;
+    uint32_t rehashes;
+    const struct Image *image;
+    Node **shells;
 };
 
+// Structure for the head of a table image, as ht_export() writes it. The
+// first word of each tree follows (one more entry marks the end), then
+// every tree's words in Eytzinger order, then the words themselves
+// salt, size = the table's salt and number of trees
+// nodes = how many words there are
+// entries = where the words start, from the start of the image
+// bytes = size of the whole image
+
+typedef struct Image {
+    uint64_t salt[2];
+    uint64_t size;
+    uint64_t nodes;
+    uint64_t entries;
+    uint64_t bytes;
+} Image;
+
+// Structure for one word of a table image, a node with offsets from the
+// start of the image in place of pointers, and no child links since each
+// tree is in Eytzinger order
+// prefix, length, key, categories = as in the node
+// oldspeak, newspeak = where the words are, 0 for an inlined oldspeak or
+// no newspeak
+
+typedef struct {
+    uint64_t prefix;
+    uint32_t length;
+    char key[NODE_INLINE];
+    Set categories;
+    uint32_t oldspeak;
+    uint32_t newspeak;
+} Entry;
+
 // The ht_create() function constructs the hash table
 // Inputs: size of the hash table
-// Outputs: a pointer to a hash table
+// Outputs: a pointer to a hash table, or null if it cannot be made
 
-HashTable *ht_create(uint32_t size) {
-    HashTable *ht = (HashTable *) calloc(size, sizeof(HashTable));
+HashTable *ht_create(uint64_t size) {
+    if (size > SIZE_MAX / sizeof(Node *)) {
+        // the tree array would not fit in the address space
+        return NULL;
+    }
+    HashTable *ht = (HashTable *) calloc(1, sizeof(HashTable));
     if (ht) {
         // set salts, size, and create trees
-        ht->salt[0] = SALT_HASHTABLE_LO;
-        ht->salt[1] = SALT_HASHTABLE_HI;
+        salts_get(SALT_HASHTABLE, ht->salt);
         ht->size = size;
-        ht->trees = (Node **) calloc(size, sizeof(Node *));
-        // start with null nodes
-        for (uint32_t i = 0; i < size; i += 1) {
-            ht->trees[i] = NULL;
+        ht->generation = salts_generation();
+        // big tables get huge pages, and come back zeroed (null nodes)
+        ht->trees = (Node **) mem_alloc((size_t) size * sizeof(Node *), -1, &ht->page);
+        if (!ht->trees) {
+            free(ht);
+            ht = NULL;
         }
     }
     return ht;
@@ -50,8 +114,8 @@ HashTable *ht_create(uint32_t size) {
 // Outputs: void
 
 void ht_print(HashTable *ht) {
-    if (ht) {
-        for (uint32_t i = 0; i < ht->size; i += 1) {
+    if (ht && ht->trees) {
+        for (uint64_t i = 0; i < ht->size; i += 1) {
             bst_print(ht->trees[i]);
         }
     }
@@ -63,14 +127,29 @@ void ht_print(HashTable *ht) {
 // Outputs: void
 
 void ht_delete(HashTable **ht) {
+    if ((*ht) && (*ht)->image) {
+        // an attached table only owns the nodes it made
+        for (uint64_t i = 0; i < (*ht)->image->nodes; i += 1) {
+            free((*ht)->shells[i]);
+        }
+        free((*ht)->shells);
+        free(*ht);
+        *ht = NULL;
+    }
     if ((*ht) && (*ht)->trees) {
+        if ((*ht)->frozen) {
+            // frozen nodes all share one allocation
+            mem_free((*ht)->frozen, (*ht)->frozen_bytes, (*ht)->frozen_page);
+            free((*ht)->counts);
+            memset((*ht)->trees, 0, (size_t) (*ht)->size * sizeof(Node *));
+        }
         // delete each tree
-        for (uint32_t i = 0; i < (*ht)->size; i += 1) {
+        for (uint64_t i = 0; i < (*ht)->size; i += 1) {
             if ((*ht)->trees[i]) {
                 bst_delete(&((*ht)->trees[i]));
             }
         }
-        free((*ht)->trees);
+        mem_free((*ht)->trees, (size_t) (*ht)->size * sizeof(Node *), (*ht)->page);
         free(*ht);
         *ht = NULL;
     }
@@ -81,10 +160,136 @@ void ht_delete(HashTable **ht) {
 // Inputs: a pointer to a hash table
 // Outputs: the size of the hash table
 
-uint32_t ht_size(HashTable *ht) {
+uint64_t ht_size(HashTable *ht) {
     return ht->size;
 }
 
+// The ht_page_size() function finds the page size the trees got
+// Inputs: a pointer to a hash table
+// Outputs: the page size in bytes
+
+size_t ht_page_size(HashTable *ht) {
+    return mem_page_size(ht->trees, (size_t) ht->size * sizeof(Node *), ht->page);
+}
+
+// The ht_tree() function gives one tree of the table, frozen or not
+// Inputs: a pointer to a hash table, the index of the tree
+// Outputs: the root of the tree
+
+Node *ht_tree(HashTable *ht, uint64_t index) {
+    return ht->image ? NULL : ht->trees[index];
+}
+
+// The ht_publish() function draws a new generation once a batch of
+// inserts is done, so answers cached before them are dropped. A lookup
+// that sees the new generation sees the new nodes too
+// Inputs: a pointer to a hash table
+// Outputs: void
+
+void ht_publish(HashTable *ht) {
+    __atomic_store_n(&ht->generation, salts_generation(), __ATOMIC_RELEASE);
+    return;
+}
+
+// The ht_generation() function gives a number that no other table, and no
+// other layout or published set of words of this table, has had
+// Inputs: a pointer to a hash table
+// Outputs: the generation
+
+uint64_t ht_generation(HashTable *ht) {
+    return __atomic_load_n(&ht->generation, __ATOMIC_ACQUIRE);
+}
+
+// The ht_search() function finds an oldspeak in a frozen tree. Node i
+// has its children at 2i + 1 and 2i + 2, so the next step is computed
+// rather than loaded, and the grandchildren are fetched ahead
+// Inputs: the tree's array and its length, the oldspeak
+// Outputs: the node with the oldspeak, or null
+
+static Node *ht_search(Node *tree, uint32_t count, char *oldspeak) {
+    uint32_t length = (uint32_t) strlen(oldspeak);
+    uint64_t prefix = node_prefix(oldspeak, length);
+    uint32_t i = 0;
+    while (i < count) {
+        __builtin_prefetch(&tree[4 * i + 3]);
+        int diff = node_compare(&tree[i], prefix, oldspeak, length);
+        if (!diff) {
+            return &tree[i];
+        }
+        // a larger node means the oldspeak is to the left
+        branches += 1;
+        i = 2 * i + 1 + (diff < 0);
+    }
+    return NULL;
+}
+
+// The shell() function gives the node of an image word, making it the
+// first time. Its words point into the image, so it costs one cache line
+// per word found, and only for words that are found
+// Inputs: a pointer to an attached hash table, the word's index
+// Outputs: the node, or null if memory ran out
+
+static Node *shell(HashTable *ht, uint64_t index) {
+    Node *n = __atomic_load_n(&ht->shells[index], __ATOMIC_ACQUIRE);
+    if (n) {
+        return n;
+    }
+    const char *image = (const char *) ht->image;
+    const Entry *e = (const Entry *) (image + ht->image->entries) + index;
+    n = (Node *) aligned_alloc(64, sizeof(Node));
+    if (!n) {
+        return NULL;
+    }
+    memset(n, 0, sizeof(Node));
+    n->prefix = e->prefix;
+    n->length = e->length;
+    memcpy(n->key, e->key, sizeof(n->key));
+    n->categories = e->categories;
+    n->oldspeak = e->oldspeak ? (char *) image + e->oldspeak : n->key;
+    n->newspeak = e->newspeak ? (char *) image + e->newspeak : NULL;
+    Node *expected = NULL;
+    if (!__atomic_compare_exchange_n(
+            &ht->shells[index], &expected, n, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // another thread made it first
+        free(n);
+        n = expected;
+    }
+    return n;
+}
+
+// The ht_search_image() function finds an oldspeak in a tree of an
+// attached table, the same walk as ht_search() over the image's entries
+// Inputs: a pointer to an attached hash table, the tree, the oldspeak
+// Outputs: the node with the oldspeak, or null
+
+static Node *ht_search_image(HashTable *ht, uint64_t index, char *oldspeak) {
+    const char *image = (const char *) ht->image;
+    const uint32_t *starts = (const uint32_t *) (ht->image + 1);
+    const Entry *tree = (const Entry *) (image + ht->image->entries) + starts[index];
+    uint32_t count = starts[index + 1] - starts[index];
+    uint32_t length = (uint32_t) strlen(oldspeak);
+    uint64_t prefix = node_prefix(oldspeak, length);
+    uint32_t i = 0;
+    while (i < count) {
+        __builtin_prefetch(&tree[4 * i + 3]);
+        const Entry *e = &tree[i];
+        int diff = e->prefix != prefix ? (e->prefix > prefix ? 1 : -1) : 0;
+        uint32_t shortest = e->length < length ? e->length : length;
+        if (!diff && shortest > 8) {
+            const char *word = e->oldspeak ? image + e->oldspeak : e->key;
+            diff = memcmp(word + 8, oldspeak + 8, shortest - 8);
+        }
+        diff = diff ? diff : (e->length > length) - (e->length < length);
+        if (!diff) {
+            return shell(ht, starts[index] + i);
+        }
+        // a larger word means the oldspeak is to the left
+        branches += 1;
+        i = 2 * i + 1 + (diff < 0);
+    }
+    return NULL;
+}
+
 // The ht_lookup() function finds the node that contains the given
 // oldspeak
 // Inputs: a pointer to a hash table, the oldspeak to lookup
@@ -93,27 +298,81 @@ uint32_t ht_size(HashTable *ht) {
 Node *ht_lookup(HashTable *ht, char *oldspeak) {
     if (ht && oldspeak) {
         lookups += 1;
-        uint32_t index = hash(ht->salt, oldspeak) % ht_size(ht);
-        // returns the node with that oldspeak
-        return bst_find(ht->trees[index], oldspeak);
+        uint64_t index = ht_bucket(ht, oldspeak);
+        if (ht->image) {
+            return ht_search_image(ht, index, oldspeak);
+        }
+        if (ht->frozen) {
+            return ht_search(ht->trees[index], ht->counts[index], oldspeak);
+        }
+        // returns the node with that oldspeak, the root may be linked in
+        // by an insert on another thread
+        return bst_find(__atomic_load_n(&ht->trees[index], __ATOMIC_ACQUIRE), oldspeak);
     } else {
         return NULL;
     }
 }
 
+// The ht_bucket() function finds which tree an oldspeak belongs in
+// Inputs: a pointer to a hash table, the oldspeak
+// Outputs: the index of the tree
+
+uint64_t ht_bucket(HashTable *ht, char *oldspeak) {
+    return hash_index(ht->salt, oldspeak, ht_size(ht));
+}
+
 // The ht_insert() function inserts an oldspeak into the hash table
 // Inputs: a pointer to a hash table, the oldspeak and newspeak
 // Outputs: void
 
 void ht_insert(HashTable *ht, char *oldspeak, char *newspeak) {
     if (ht && oldspeak) {
+        ht_insert_bucket(ht, ht_bucket(ht, oldspeak), oldspeak, newspeak);
+    }
+    return;
+}
+
+// The ht_insert_bucket() function inserts an oldspeak into a tree that
+// was already picked with ht_bucket(). Inserts are lock-free, so they can
+// run alongside other inserts and lookups on any tree. A frozen table
+// takes no more inserts
+// Inputs: a pointer to a hash table, the index of the tree, the oldspeak
+// and newspeak
+// Outputs: the node holding the oldspeak, or null if it was not inserted
+
+Node *ht_insert_bucket(HashTable *ht, uint64_t index, char *oldspeak, char *newspeak) {
+    if (ht && oldspeak && !ht->frozen && !ht->image) {
         lookups += 1;
-        uint32_t index = hash(ht->salt, oldspeak) % ht_size(ht);
         // if it does not exist, it makes a new node there
-        // if it does exist, new value replaces it
-        ht->trees[index] = bst_insert(ht->trees[index], oldspeak, newspeak);
+        // if it does exist, the node already there is kept
+        return bst_insert_at(&ht->trees[index], oldspeak, newspeak);
     }
-    return;
+    return NULL;
+}
+
+// The tree_size() function counts the words in one tree, attached or not
+// Inputs: a pointer to a hash table, the index of the tree
+// Outputs: the number of words
+
+static uint32_t tree_size(HashTable *ht, uint64_t index) {
+    if (ht->image) {
+        const uint32_t *starts = (const uint32_t *) (ht->image + 1);
+        return starts[index + 1] - starts[index];
+    }
+    return bst_size(ht->trees[index]);
+}
+
+// The tree_height() function finds the height of one tree, an image tree
+// is in Eytzinger order, so as short as its size allows
+// Inputs: a pointer to a hash table, the index of the tree
+// Outputs: the height
+
+static uint32_t tree_height(HashTable *ht, uint64_t index) {
+    if (ht->image) {
+        uint32_t size = tree_size(ht, index);
+        return size ? 32 - (uint32_t) __builtin_clz(size) : 0;
+    }
+    return bst_height(ht->trees[index]);
 }
 
 // The ht_count() function counts the number of non-null BSTs in
@@ -121,10 +380,10 @@ void ht_insert(HashTable *ht, char *oldspeak, char *newspeak) {
 // Inputs: a pointer to a hash table
 // Outputs: the count of non-null BSTs
 
-uint32_t ht_count(HashTable *ht) {
-    uint32_t count = 0;
-    for (uint32_t i = 0; i < ht->size; i += 1) {
-        if (ht->trees[i]) {
+uint64_t ht_count(HashTable *ht) {
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        if (ht->image ? tree_size(ht, i) != 0 : ht->trees[i] != NULL) {
             // add to count if node is valid
             count += 1;
         }
@@ -132,6 +391,30 @@ uint32_t ht_count(HashTable *ht) {
     return count;
 }
 
+// The ht_bytes() function finds how much memory the hash table uses,
+// counting the trees' nodes and words
+// Inputs: a pointer to a hash table
+// Outputs: the size in bytes
+
+uint64_t ht_bytes(HashTable *ht) {
+    if (ht->image) {
+        // the shared image, and the nodes made for the words found
+        uint64_t bytes = sizeof(HashTable) + ht->image->bytes + ht->image->nodes * sizeof(Node *);
+        for (uint64_t i = 0; i < ht->image->nodes; i += 1) {
+            bytes += ht->shells[i] ? sizeof(Node) : 0;
+        }
+        return bytes;
+    }
+    uint64_t bytes = sizeof(HashTable) + ht->size * sizeof(Node *);
+    if (ht->frozen) {
+        bytes += ht->size * sizeof(uint32_t);
+    }
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        bytes += bst_bytes(ht->trees[i]);
+    }
+    return bytes;
+}
+
 // The ht_avg_bst_size() function finds the average size of the
 // binary search tree (BST)
 // Inputs: a pointer to a hash table
@@ -140,8 +423,8 @@ uint32_t ht_count(HashTable *ht) {
 double ht_avg_bst_size(HashTable *ht) {
     double sum = 0;
     // find the total size
-    for (uint32_t i = 0; i < ht_size(ht); i += 1) {
-        sum += bst_size(ht->trees[i]);
+    for (uint64_t i = 0; i < ht_size(ht); i += 1) {
+        sum += tree_size(ht, i);
     }
     // divide the total size by count
     if (ht_count(ht)) {
@@ -159,8 +442,8 @@ double ht_avg_bst_size(HashTable *ht) {
 double ht_avg_bst_height(HashTable *ht) {
     double sum = 0;
     // find the total height
-    for (uint32_t i = 0; i < ht_size(ht); i += 1) {
-        sum += bst_height(ht->trees[i]);
+    for (uint64_t i = 0; i < ht_size(ht); i += 1) {
+        sum += tree_height(ht, i);
     }
     // divide the total height by count
     if (ht_count(ht)) {
@@ -169,3 +452,341 @@ double ht_avg_bst_height(HashTable *ht) {
         return 0;
     }
 }
+
+// The sort_tree() function lists the nodes of a tree in order
+// Inputs: the root, where the list goes, how many are in it
+// Outputs: void
+
+static void sort_tree(Node *root, Node **sorted, uint32_t *count) {
+    if (root) {
+        sort_tree(root->left, sorted, count);
+        sorted[(*count)++] = root;
+        sort_tree(root->right, sorted, count);
+    }
+    return;
+}
+
+// The pack() function copies a word into the frozen allocation
+// Inputs: the word, where the next word goes
+// Outputs: the copy
+
+static char *pack(const char *word, char **pool) {
+    size_t length = strlen(word) + 1;
+    char *copy = (char *) memcpy(*pool, word, length);
+    *pool += length;
+    return copy;
+}
+
+// The eytzinger() function lays out sorted nodes in Eytzinger order,
+// an in-order walk of the implicit tree rooted at k
+// Inputs: the sorted nodes, the array to fill and its length, the next
+// sorted node to place, the slot k, where packed words go
+// Outputs: the next sorted node to place
+
+static uint32_t eytzinger(
+    Node **sorted, Node *tree, uint32_t count, uint32_t next, uint32_t k, char **pool) {
+    if (k < count) {
+        next = eytzinger(sorted, tree, count, next, 2 * k + 1, pool);
+        Node *n = &tree[k];
+        memcpy(n, sorted[next++], sizeof(Node));
+        n->oldspeak = n->length < NODE_INLINE ? n->key : pack(n->oldspeak, pool);
+        n->newspeak = n->newspeak ? pack(n->newspeak, pool) : NULL;
+        // child links still work for the tree walks used by statistics
+        n->left = 2 * k + 1 < count ? &tree[2 * k + 1] : NULL;
+        n->right = 2 * k + 2 < count ? &tree[2 * k + 2] : NULL;
+        next = eytzinger(sorted, tree, count, next, 2 * k + 2, pool);
+    }
+    return next;
+}
+
+// The relink() function hangs an existing node in a tree, where
+// bst_insert_at() would have put a new one
+// Inputs: the root link, the node
+// Outputs: void
+
+static void relink(Node **link, Node *n) {
+    while (*link) {
+        int diff = node_compare(*link, n->prefix, n->oldspeak, n->length);
+        link = diff > 0 ? &(*link)->left : &(*link)->right;
+    }
+    *link = n;
+    return;
+}
+
+// The move() function moves every node of a tree into the new trees,
+// parents before children so a tree that stays together keeps its shape
+// Inputs: the hash table (with its new salt), the new trees, the root
+// Outputs: void
+
+static void move(HashTable *ht, Node **trees, Node *root) {
+    if (root) {
+        Node *left = root->left, *right = root->right;
+        root->left = root->right = NULL;
+        relink(&trees[ht_bucket(ht, root->oldspeak)], root);
+        move(ht, trees, left);
+        move(ht, trees, right);
+    }
+    return;
+}
+
+// The ht_rehash() function draws a fresh salt and moves every node to
+// the tree it hashes to now. Nodes are moved, not copied, so nothing
+// that points at them changes. No other thread may use the table
+// meanwhile, and a frozen or attached table cannot be rehashed
+// Inputs: a pointer to a hash table
+// Outputs: false if memory ran out or the table is frozen, the table is
+// unchanged then
+
+bool ht_rehash(HashTable *ht) {
+    size_t page;
+    Node **trees = ht->frozen || ht->image
+                       ? NULL
+                       : (Node **) mem_alloc((size_t) ht->size * sizeof(Node *), -1, &page);
+    if (!trees) {
+        return false;
+    }
+    Node **old = ht->trees;
+    salts_fresh(ht->salt);
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        move(ht, trees, old[i]);
+    }
+    mem_free(old, (size_t) ht->size * sizeof(Node *), ht->page);
+    ht->trees = trees;
+    ht->page = page;
+    ht->rehashes += 1;
+    return true;
+}
+
+// The ht_max_height() function finds the height of the deepest tree
+// Inputs: a pointer to a hash table
+// Outputs: the height
+
+uint32_t ht_max_height(HashTable *ht) {
+    uint32_t deepest = 0;
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        uint32_t height = tree_height(ht, i);
+        deepest = height > deepest ? height : deepest;
+    }
+    return deepest;
+}
+
+// The ht_balance() function rehashes the table with fresh salts, a few
+// times at most, while some tree is deeper than HT_DEPTH plus what its
+// load alone would explain. Words made to pile into one tree under one
+// salt are spread out under the next
+// Inputs: a pointer to a hash table
+// Outputs: false if memory ran out
+
+bool ht_balance(HashTable *ht) {
+    uint64_t words = 0;
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        words += bst_size(ht->trees[i]);
+    }
+    uint32_t limit = HT_DEPTH + (uint32_t) (3 * log2(1 + (double) words / (double) ht->size));
+    for (uint32_t i = 0; i < HT_REHASHES && ht_max_height(ht) > limit; i += 1) {
+        if (!ht_rehash(ht)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The ht_rehashes() function counts the rehashes so far
+// Inputs: a pointer to a hash table
+// Outputs: the number of rehashes
+
+uint32_t ht_rehashes(HashTable *ht) {
+    return ht->rehashes;
+}
+
+// The ht_salt() function gives the table's current salt
+// Inputs: a pointer to a hash table, where the salt goes
+// Outputs: void
+
+void ht_salt(HashTable *ht, uint64_t salt[2]) {
+    salt[0] = ht->salt[0];
+    salt[1] = ht->salt[1];
+    return;
+}
+
+// The ht_freeze() function rewrites every tree as an array in Eytzinger
+// order, all in one allocation with the words packed after the nodes.
+// Lookups then walk dense memory instead of chasing pointers. No other
+// thread may use the table while it freezes, and it takes no inserts
+// after
+// Inputs: a pointer to a hash table
+// Outputs: false if memory ran out, the table is unchanged then
+
+bool ht_freeze(HashTable *ht) {
+    if (ht->frozen || ht->image) {
+        return true;
+    }
+    uint64_t nodes = 0, words = 0;
+    uint32_t largest = 0;
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        uint32_t size = bst_size(ht->trees[i]);
+        nodes += size;
+        largest = size > largest ? size : largest;
+    }
+    Node **sorted = (Node **) malloc((largest ? largest : 1) * sizeof(Node *));
+    uint32_t *counts = (uint32_t *) calloc(ht->size ? ht->size : 1, sizeof(uint32_t));
+    for (uint64_t i = 0; sorted && i < ht->size; i += 1) {
+        uint32_t count = 0;
+        sort_tree(ht->trees[i], sorted, &count);
+        for (uint32_t j = 0; j < count; j += 1) {
+            if (sorted[j]->oldspeak != sorted[j]->key) {
+                words += sorted[j]->length + 1;
+            }
+            if (sorted[j]->newspeak) {
+                words += strlen(sorted[j]->newspeak) + 1;
+            }
+        }
+    }
+    size_t bytes = (size_t) (nodes * sizeof(Node) + words);
+    size_t page = 0;
+    Node *frozen = sorted && counts ? (Node *) mem_alloc(bytes ? bytes : 1, -1, &page) : NULL;
+    if (!frozen) {
+        free(sorted);
+        free(counts);
+        return false;
+    }
+    Node *next = frozen;
+    char *pool = (char *) (frozen + nodes);
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        uint32_t count = 0;
+        sort_tree(ht->trees[i], sorted, &count);
+        eytzinger(sorted, next, count, 0, 0, &pool);
+        bst_delete(&ht->trees[i]);
+        ht->trees[i] = count ? next : NULL;
+        counts[i] = count;
+        next += count;
+    }
+    free(sorted);
+    ht->frozen = frozen;
+    ht->counts = counts;
+    ht->frozen_bytes = bytes ? bytes : 1;
+    ht->frozen_page = page;
+    // every node moved
+    ht->generation = salts_generation();
+    return true;
+}
+
+// The tally() function counts the nodes of a tree and the bytes their
+// words take outside the nodes
+// Inputs: the root, the node and byte counts to add to
+// Outputs: void
+
+static void tally(Node *root, uint64_t *nodes, uint64_t *words) {
+    if (root) {
+        *nodes += 1;
+        *words += root->length < NODE_INLINE ? 0 : root->length + 1;
+        *words += root->newspeak ? strlen(root->newspeak) + 1 : 0;
+        tally(root->left, nodes, words);
+        tally(root->right, nodes, words);
+    }
+    return;
+}
+
+// The place() function lays out sorted nodes as image entries in
+// Eytzinger order, like eytzinger() does for a frozen table
+// Inputs: the sorted nodes, the entries to fill and how many, the next
+// sorted node to place, the slot k, the image, where the next word goes
+// Outputs: the next sorted node to place
+
+static uint32_t place(Node **sorted, Entry *tree, uint32_t count, uint32_t next, uint32_t k,
+    char *image, uint64_t *pool) {
+    if (k < count) {
+        next = place(sorted, tree, count, next, 2 * k + 1, image, pool);
+        Node *n = sorted[next++];
+        Entry *e = &tree[k];
+        memset(e, 0, sizeof(Entry));
+        e->prefix = n->prefix;
+        e->length = n->length;
+        memcpy(e->key, n->key, sizeof(e->key));
+        e->categories = n->categories;
+        if (n->length >= NODE_INLINE) {
+            e->oldspeak = (uint32_t) *pool;
+            *pool += (uint64_t) strlen(strcpy(image + *pool, n->oldspeak)) + 1;
+        }
+        if (n->newspeak) {
+            e->newspeak = (uint32_t) *pool;
+            *pool += (uint64_t) strlen(strcpy(image + *pool, n->newspeak)) + 1;
+        }
+        next = place(sorted, tree, count, next, 2 * k + 2, image, pool);
+    }
+    return next;
+}
+
+// The ht_export() function writes the table as an image with offsets in
+// place of pointers, so it can be placed anywhere, for a shared segment.
+// Each tree becomes an Eytzinger array, as ht_freeze() would make it
+// Inputs: a pointer to a hash table, where the image goes (null to only
+// find its size)
+// Outputs: the size of the image in bytes, 0 if memory ran out or the
+// image would be too big for 32-bit offsets
+
+uint64_t ht_export(HashTable *ht, void *to) {
+    uint64_t nodes = 0, words = 0;
+    uint32_t largest = 0;
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        uint64_t before = nodes;
+        tally(ht->trees[i], &nodes, &words);
+        largest = nodes - before > largest ? (uint32_t) (nodes - before) : largest;
+    }
+    uint64_t entries = (sizeof(Image) + (ht->size + 1) * sizeof(uint32_t) + 7) & ~(uint64_t) 7;
+    uint64_t bytes = entries + nodes * sizeof(Entry) + words;
+    if (bytes > UINT32_MAX) {
+        return 0;
+    }
+    if (!to) {
+        return bytes;
+    }
+    Node **sorted = (Node **) malloc((largest ? largest : 1) * sizeof(Node *));
+    if (!sorted) {
+        return 0;
+    }
+    char *image = (char *) to;
+    Image head = { { ht->salt[0], ht->salt[1] }, ht->size, nodes, entries, bytes };
+    memcpy(image, &head, sizeof(Image));
+    uint32_t *starts = (uint32_t *) (image + sizeof(Image));
+    Entry *next = (Entry *) (image + entries);
+    uint64_t pool = entries + nodes * sizeof(Entry);
+    uint32_t placed = 0;
+    for (uint64_t i = 0; i < ht->size; i += 1) {
+        uint32_t count = 0;
+        sort_tree(ht->trees[i], sorted, &count);
+        place(sorted, next, count, 0, 0, image, &pool);
+        starts[i] = placed;
+        placed += count;
+        next += count;
+    }
+    starts[ht->size] = placed;
+    free(sorted);
+    return bytes;
+}
+
+// The ht_attach() function makes a read-only hash table of an image from
+// ht_export(), searching the trees where they lie. It takes no inserts
+// Inputs: the image, which has to outlive the table
+// Outputs: a pointer to the hash table, or null if memory ran out
+
+HashTable *ht_attach(const void *image) {
+    HashTable *ht = (HashTable *) calloc(1, sizeof(HashTable));
+    if (!ht) {
+        return NULL;
+    }
+    ht->image = (const Image *) image;
+    ht->salt[0] = ht->image->salt[0];
+    ht->salt[1] = ht->image->salt[1];
+    ht->size = ht->image->size;
+    ht->generation = salts_generation();
+    long page = sysconf(_SC_PAGESIZE);
+    ht->page = page > 0 ? (size_t) page : 4096;
+    // zeroed pages, only the ones holding found words get touched
+    ht->shells = (Node **) calloc(ht->image->nodes ? ht->image->nodes : 1, sizeof(Node *));
+    if (!ht->shells) {
+        free(ht);
+        return NULL;
+    }
+    return ht;
+}
@@ -2,26 +2,63 @@
 
 #include "bst.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-extern uint64_t lookups;
+extern _Thread_local uint64_t lookups;
+
+// Deepest a tree may get, beyond what the load explains, before the table
+// is rehashed with fresh salts, and how many times that is tried
+#define HT_DEPTH    12
+#define HT_REHASHES 3
 
 typedef struct HashTable HashTable;
 
-HashTable *ht_create(uint32_t size);
+HashTable *ht_create(uint64_t size);
 
 void ht_delete(HashTable **ht);
 
-uint32_t ht_size(HashTable *ht);
+uint64_t ht_size(HashTable *ht);
+
+size_t ht_page_size(HashTable *ht);
+
+void ht_publish(HashTable *ht);
+
+uint64_t ht_generation(HashTable *ht);
+
+Node *ht_tree(HashTable *ht, uint64_t index);
 
 Node *ht_lookup(HashTable *ht, char *oldspeak);
 
+uint64_t ht_bucket(HashTable *ht, char *oldspeak);
+
 void ht_insert(HashTable *ht, char *oldspeak, char *newspeak);
 
-uint32_t ht_count(HashTable *ht);
+Node *ht_insert_bucket(HashTable *ht, uint64_t index, char *oldspeak, char *newspeak);
+
+uint64_t ht_count(HashTable *ht);
+
+uint64_t ht_bytes(HashTable *ht);
 
 double ht_avg_bst_size(HashTable *ht);
 
 double ht_avg_bst_height(HashTable *ht);
 
+bool ht_rehash(HashTable *ht);
+
+uint32_t ht_max_height(HashTable *ht);
+
+bool ht_balance(HashTable *ht);
+
+uint32_t ht_rehashes(HashTable *ht);
+
+void ht_salt(HashTable *ht, uint64_t salt[2]);
+
+bool ht_freeze(HashTable *ht);
+
+uint64_t ht_export(HashTable *ht, void *to);
+
+HashTable *ht_attach(const void *image);
+
 void ht_print(HashTable *ht);
@@ -0,0 +1,181 @@
+// The filter as a library for other programs. Everything a filter needs
+// lives in its BhFilter, and everything a scan needs lives on the calling
+// thread's stack or in its BhResult, so one filter can be shared by many
+// scanning threads and several filters can live in one process. The
+// branch and lookup counters are thread local, bh_scan() hands back only
+// what its own call added.
+#include "libbanhammer.h"
+#include "bst.h"
+#include "loader.h"
+#include "scanner.h"
+#include "utf8.h"
+#include "verdict.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Structure for BhFilter
+// dict = the loaded dictionary
+// unicode = tokenize as UTF-8
+// chars = which ASCII bytes make words for this filter
+// quick = scans only classify
+
+struct BhFilter {
+    Dictionary dict;
+    bool unicode;
+    bool chars[128];
+    bool quick;
+};
+
+// The bh_close() function frees a filter, no scan may still be using it
+// Inputs: a pointer to the pointer to the filter
+// Outputs: void
+
+void bh_close(BhFilter **f) {
+    if (*f) {
+        bf_delete(&(*f)->dict.bf);
+        ht_delete(&(*f)->dict.ht);
+        pf_delete(&(*f)->dict.pf);
+        bf_delete(&(*f)->dict.phrases);
+        fuzzy_delete(&(*f)->dict.fuzzy);
+        trie_delete(&(*f)->dict.trie);
+        free(*f);
+        *f = NULL;
+    }
+    return;
+}
+
+// The bh_open() function loads a dictionary into a new filter
+// Inputs: the badspeak and newspeak files, the options (may be null for
+// all defaults)
+// Outputs: a pointer to the filter, or null if it could not be loaded
+
+BhFilter *bh_open(const char *badfile, const char *newfile, const BhOptions *options) {
+    BhOptions none;
+    memset(&none, 0, sizeof(none));
+    const BhOptions *o = options ? options : &none;
+    BhFilter *f = (BhFilter *) calloc(1, sizeof(BhFilter));
+    if (!f) {
+        return NULL;
+    }
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t threads = o->threads ? o->threads : cores > 0 ? (uint32_t) cores : 1;
+    f->unicode = o->unicode;
+    f->quick = o->verdict_only;
+    memcpy(f->chars, utf8_ascii_word, sizeof(f->chars));
+    f->dict.bf = o->fp_rate > 0 ? bf_create_scalable(o->fp_rate)
+                                : bf_create(o->filter_size ? o->filter_size : 1 << 20);
+    f->dict.ht = ht_create(o->table_size ? o->table_size : 1 << 16);
+    f->dict.pf = o->prefilter ? pf_create() : NULL;
+    f->dict.fuzzy = o->fuzzy ? fuzzy_create(o->fuzzy) : NULL;
+    f->dict.categories = CATEGORY_FIRST + o->categories;
+    f->dict.stems = o->stems;
+    char *files[CATEGORY_MAX] = { (char *) badfile, (char *) newfile };
+    for (uint32_t c = 0; c < o->categories && c + CATEGORY_FIRST < CATEGORY_MAX; c += 1) {
+        files[c + CATEGORY_FIRST] = (char *) o->category_files[c];
+    }
+    for (const char *c = f->dict.fuzzy ? fuzzy_chars(f->dict.fuzzy) : ""; *c; c += 1) {
+        // look-alike characters stay inside words, for this filter only
+        if ((uint8_t) *c < 128) {
+            f->chars[(uint8_t) *c] = true;
+        }
+    }
+    if (!f->dict.bf || !f->dict.ht || (o->prefilter && !f->dict.pf) || (o->fuzzy && !f->dict.fuzzy)
+        || !load_dictionary(files, f->dict.categories, &f->dict, o->unicode, threads)
+        || (o->freeze && !ht_freeze(f->dict.ht))
+        || (o->trie && !(f->dict.trie = trie_create(f->dict.ht)))) {
+        bh_close(&f);
+    }
+    return f;
+}
+
+// The count_tree() function counts the nodes of a tree
+// Inputs: the root
+// Outputs: the number of nodes
+
+static size_t count_tree(Node *root) {
+    return root ? 1 + count_tree(root->left) + count_tree(root->right) : 0;
+}
+
+// The copy_tree() function copies the words of a tree into matches, in
+// order
+// Inputs: the root, where the matches go, how many are filled in
+// Outputs: false if memory ran out
+
+static bool copy_tree(Node *root, BhMatch *matches, size_t *count) {
+    if (!root) {
+        return true;
+    }
+    if (!copy_tree(root->left, matches, count)) {
+        return false;
+    }
+    BhMatch *m = &matches[*count];
+    m->oldspeak = strdup(root->oldspeak);
+    m->newspeak = root->newspeak ? strdup(root->newspeak) : NULL;
+    m->categories = root->categories;
+    if (!m->oldspeak || (root->newspeak && !m->newspeak)) {
+        free(m->oldspeak);
+        free(m->newspeak);
+        return false;
+    }
+    *count += 1;
+    return copy_tree(root->right, matches, count);
+}
+
+// The bh_scan() function checks a message against the filter, safe to
+// call from many threads on the same filter
+// Inputs: the filter, the message and its length, where the result goes
+// (free it with bh_result_free())
+// Outputs: false if memory ran out
+
+bool bh_scan(BhFilter *f, const char *buffer, size_t length, BhResult *result) {
+    memset(result, 0, sizeof(*result));
+    uint64_t branches_before = branches;
+    uint64_t lookups_before = lookups;
+    Verdict v;
+    memset(&v, 0, sizeof(v));
+    v.quick = f->quick;
+    Scanner *s = scanner_create_buffer(buffer, length, !f->unicode);
+    if (!s) {
+        return false;
+    }
+    scanner_word_chars(s, f->chars);
+    verdict_scan(&v, &f->dict, s);
+    scanner_delete(&s);
+
+    result->thoughtcrime = member_set(THOUGHTCRIME, v.punishment);
+    result->rightspeak = member_set(RIGHTSPEAK, v.punishment);
+    result->categories = v.categories;
+    result->scanned = v.scanned;
+    result->rejected = v.rejected;
+    size_t count = count_tree(v.badwords_list) + count_tree(v.badwords_list_with_newspeak)
+                   + count_tree(v.categorized_list);
+    result->matches = count ? (BhMatch *) calloc(count, sizeof(BhMatch)) : NULL;
+    bool ok = !count
+              || (result->matches && copy_tree(v.badwords_list, result->matches, &result->count)
+                  && copy_tree(v.badwords_list_with_newspeak, result->matches, &result->count)
+                  && copy_tree(v.categorized_list, result->matches, &result->count));
+    verdict_delete(&v);
+    result->branches = branches - branches_before;
+    result->lookups = lookups - lookups_before;
+    if (!ok) {
+        bh_result_free(result);
+    }
+    return ok;
+}
+
+// The bh_result_free() function frees what a scan found
+// Inputs: a pointer to the result
+// Outputs: void
+
+void bh_result_free(BhResult *result) {
+    for (size_t i = 0; i < result->count; i += 1) {
+        free(result->matches[i].oldspeak);
+        free(result->matches[i].newspeak);
+    }
+    free(result->matches);
+    result->matches = NULL;
+    result->count = 0;
+    return;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+// libbanhammer: the filter as a library. A filter is loaded once with
+// bh_open() and can then be scanned by any number of threads at the same
+// time; every call keeps its state in its own result.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Marks the functions the library exports, everything else in it is built
+// with hidden visibility so it cannot clash with the embedding program
+#define BH_API __attribute__((visibility("default")))
+
+typedef struct BhFilter BhFilter;
+
+// Structure for the options of a filter, zero means the default
+// table_size = hash table trees (2^16)
+// filter_size = bloom filter bits (2^20)
+// fp_rate = grow the bloom filter to keep this false positive rate (off)
+// threads = threads used to load the dictionary (one per core)
+// prefilter = reject words by length and bigram before hashing
+// unicode = tokenize and case fold as UTF-8
+// fuzzy = look-alike map for fuzzy matching, as from/to pairs (off)
+// freeze = pack the hash table into dense arrays once loaded (off)
+// category_files, categories = more word lists and how many, the words of
+// list i are reported with category bit i + 2 (badspeak is bit 0 and
+// newspeak bit 1)
+// trie = look words up in a trie walked while tokenizing (off)
+// stems = also match inflected words by their stem (off)
+// verdict_only = only classify, no matches, stop once both crimes are found
+
+typedef struct {
+    uint64_t table_size;
+    uint64_t filter_size;
+    double fp_rate;
+    uint32_t threads;
+    bool prefilter;
+    bool unicode;
+    const char *fuzzy;
+    bool freeze;
+    const char **category_files;
+    uint32_t categories;
+    bool verdict_only;
+    bool trie;
+    bool stems;
+} BhOptions;
+
+// Structure for one word or phrase found
+// oldspeak = the word as it appeared, folded
+// newspeak = what to say instead, null for badspeak
+// categories = bit n is set if the word is listed in category n
+
+typedef struct {
+    char *oldspeak;
+    char *newspeak;
+    uint64_t categories;
+} BhMatch;
+
+// Structure for the result of one scan
+// thoughtcrime, rightspeak = badspeak and oldspeak were found
+// categories = every category something found is listed in
+// matches = what was found, badspeak first, then newspeak, then words
+// only in added categories, each part sorted
+// count = how many matches there are
+// scanned, rejected = words seen, and turned away by the prefilter
+// branches, lookups = tree links followed and hash table lookups made
+
+typedef struct {
+    bool thoughtcrime;
+    bool rightspeak;
+    uint64_t categories;
+    BhMatch *matches;
+    size_t count;
+    uint64_t scanned;
+    uint64_t rejected;
+    uint64_t branches;
+    uint64_t lookups;
+} BhResult;
+
+BH_API BhFilter *bh_open(const char *badfile, const char *newfile, const BhOptions *options);
+
+BH_API bool bh_scan(BhFilter *f, const char *buffer, size_t length, BhResult *result);
+
+BH_API void bh_result_free(BhResult *result);
+
+BH_API void bh_close(BhFilter **f);
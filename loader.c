@@ -0,0 +1,349 @@
+// Loads badspeak.txt, newspeak.txt and any category files into the bloom
+// filter, hash table and prefilter, and the fuzzy index when there is one.
+// Every line is one entry: a word or a phrase of up to PHRASE_MAX words,
+// followed in newspeak.txt by its newspeak. A word listed in several files
+// gets one node carrying every file's category bit, so one lookup finds
+// them all. The files are read in one go and the work
+// is split across threads: every thread hashes a slice of the words
+// straight into the shared bloom filter and prefilter, whose inserts are
+// atomic, then inserts into its own range of hash table trees, so no
+// locks are needed on the insert path. A scalable bloom filter grows in
+// insert order, so it is filled in order on the calling thread.
+#include "loader.h"
+#include "bst.h"
+#include "phrase.h"
+#include "utf8.h"
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Structure for a dictionary entry
+// oldspeak, newspeak = the words (newspeak is null for badspeak)
+// words = how many words the oldspeak has, more than 1 for a phrase
+// categories = the category of the file the entry came from
+// bucket = the hash table tree the oldspeak goes in
+// node = the hash table node the entry ended up in
+
+typedef struct {
+    char *oldspeak;
+    char *newspeak;
+    uint32_t words;
+    Set categories;
+    uint64_t bucket;
+    Node *node;
+} Entry;
+
+// Structure for the work given to one loader thread
+// entries, count = every entry in file order
+// first, last = the entries this thread hashes
+// low, high = the hash table trees this thread owns
+// bf, pf = the shared filters (bf is null when it is scalable)
+// branches, lookups = statistics counted by this thread
+
+typedef struct {
+    Entry *entries;
+    size_t count;
+    size_t first;
+    size_t last;
+    uint64_t low;
+    uint64_t high;
+    bool fold;
+    BloomFilter *bf;
+    Prefilter *pf;
+    HashTable *ht;
+    uint64_t branches;
+    uint64_t lookups;
+} Loader;
+
+// The read_file() function reads a whole file into memory
+// Inputs: the path, where to store the size
+// Outputs: a null terminated buffer with the file's contents, or null
+
+static char *read_file(char *path, size_t *size) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return NULL;
+    }
+    size_t capacity = 1 << 16;
+    size_t length = 0;
+    char *text = (char *) malloc(capacity);
+    size_t got;
+    while (text && (got = fread(text + length, 1, capacity - length - 1, file)) > 0) {
+        length += got;
+        if (capacity - length - 1 == 0) {
+            capacity *= 2;
+            char *bigger = (char *) realloc(text, capacity);
+            if (!bigger) {
+                free(text);
+            }
+            text = bigger;
+        }
+    }
+    fclose(file);
+    if (text) {
+        text[length] = '\0';
+        *size = length;
+    }
+    return text;
+}
+
+// The split_lines() function cuts a buffer into lines in place, with the
+// words of each line separated by single spaces and blank lines dropped
+// Inputs: the buffer, its size, where to store the number of lines
+// Outputs: an array of pointers to the lines
+
+static char **split_lines(char *text, size_t size, size_t *count) {
+    size_t capacity = 1024;
+    char **lines = (char **) malloc(capacity * sizeof(char *));
+    *count = 0;
+    size_t i = 0;
+    while (lines && i < size) {
+        // squeeze the line's words together, writing never passes reading
+        char *line = text + i;
+        size_t used = 0;
+        while (i < size && text[i] != '\n') {
+            while (i < size && text[i] != '\n' && isspace((unsigned char) text[i])) {
+                i += 1;
+            }
+            if (i == size || text[i] == '\n') {
+                break;
+            }
+            if (used) {
+                line[used++] = ' ';
+            }
+            while (i < size && !isspace((unsigned char) text[i])) {
+                line[used++] = text[i++];
+            }
+        }
+        i += 1; // skip the newline
+        if (!used) {
+            continue;
+        }
+        line[used] = '\0';
+        if (*count == capacity) {
+            capacity *= 2;
+            char **bigger = (char **) realloc(lines, capacity * sizeof(char *));
+            if (!bigger) {
+                free(lines);
+                return NULL;
+            }
+            lines = bigger;
+        }
+        lines[(*count)++] = line;
+    }
+    return lines;
+}
+
+// The count_words() function counts the words in a line
+// Inputs: the line, words separated by single spaces
+// Outputs: the number of words
+
+static uint32_t count_words(const char *line) {
+    uint32_t words = 1;
+    for (; *line; line += 1) {
+        words += *line == ' ';
+    }
+    return words;
+}
+
+// The hash_slice() function is the first loader pass, it folds and hashes
+// one slice of the entries into the filters
+// Inputs: a pointer to the thread's Loader
+// Outputs: null
+
+static void *hash_slice(void *arg) {
+    Loader *l = (Loader *) arg;
+    for (size_t i = l->first; i < l->last; i += 1) {
+        Entry *e = &l->entries[i];
+        if (l->fold) {
+            // fold the dictionary the same way the input is folded
+            utf8_fold_word(e->oldspeak);
+        }
+        // phrases only go in the phrase filter, added later
+        if (l->bf && e->words == 1) {
+            bf_insert(l->bf, e->oldspeak);
+        }
+        if (l->pf && e->words == 1) {
+            pf_insert(l->pf, e->oldspeak);
+        }
+        e->bucket = ht_bucket(l->ht, e->oldspeak);
+    }
+    return NULL;
+}
+
+// The insert_range() function is the second loader pass, it inserts every
+// entry that falls in the thread's trees, in file order
+// Inputs: a pointer to the thread's Loader
+// Outputs: null
+
+static void *insert_range(void *arg) {
+    Loader *l = (Loader *) arg;
+    uint64_t branches_before = branches;
+    uint64_t lookups_before = lookups;
+    for (size_t i = 0; i < l->count; i += 1) {
+        Entry *e = &l->entries[i];
+        if (e->bucket >= l->low && e->bucket < l->high) {
+            e->node = ht_insert_bucket(l->ht, e->bucket, e->oldspeak, e->newspeak);
+            if (e->node) {
+                // the thread owns the tree, so no other thread touches it
+                e->node->categories = union_set(e->node->categories, e->categories);
+            }
+        }
+    }
+    // hand the counts back, they are thread local, and leave this
+    // thread's own as they were in case it is the calling thread
+    l->branches = branches - branches_before;
+    l->lookups = lookups - lookups_before;
+    branches = branches_before;
+    lookups = lookups_before;
+    return NULL;
+}
+
+// The run_threads() function runs one loader pass on every thread. The
+// slices of threads that could not be started run on the calling thread
+// Inputs: the pass, the loaders, how many threads there are
+// Outputs: void
+
+static void run_threads(void *(*pass)(void *), Loader *loaders, uint32_t threads) {
+    pthread_t *ids = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    uint32_t started = 0;
+    for (; ids && started < threads; started += 1) {
+        if (pthread_create(&ids[started], NULL, pass, &loaders[started])) {
+            break;
+        }
+    }
+    for (uint32_t t = started; t < threads; t += 1) {
+        pass(&loaders[t]);
+    }
+    for (uint32_t t = 0; t < started; t += 1) {
+        pthread_join(ids[t], NULL);
+    }
+    free(ids);
+    return;
+}
+
+// The load_dictionary() function fills the filters and hash table from
+// the badspeak, newspeak and category files
+// Inputs: the file of each category, in category order (badspeak, then
+// newspeak, then the named ones), how many there are, the dictionary
+// whose bloom filter, hash table, prefilter and fuzzy index (may be null)
+// get filled and whose phrase filter gets made, whether to case fold the
+// words, and how many threads to use
+// Outputs: true if everything was loaded
+
+bool load_dictionary(
+    char **files, uint32_t categories, Dictionary *dict, bool fold, uint32_t threads) {
+    BloomFilter *bf = dict->bf;
+    HashTable *ht = dict->ht;
+    Prefilter *pf = dict->pf;
+    char *texts[CATEGORY_MAX] = { NULL };
+    char **lines[CATEGORY_MAX] = { NULL };
+    size_t counts[CATEGORY_MAX] = { 0 };
+    size_t count = 0;
+    bool ok = categories <= CATEGORY_MAX;
+    for (uint32_t c = 0; ok && c < categories; c += 1) {
+        size_t size = 0;
+        texts[c] = read_file(files[c], &size);
+        lines[c] = texts[c] ? split_lines(texts[c], size, &counts[c]) : NULL;
+        ok = lines[c] != NULL;
+        count += counts[c];
+    }
+    // entries are in file order, badspeak first
+    Entry *entries = (Entry *) calloc(count + 1, sizeof(Entry));
+    Loader *loaders = (Loader *) calloc(threads, sizeof(Loader));
+    ok = ok && entries && loaders;
+    size_t phrases = 0;
+
+    if (ok) {
+        size_t e = 0;
+        for (uint32_t c = 0; c < categories; c += 1) {
+            for (size_t i = 0; i < counts[c]; i += 1, e += 1) {
+                entries[e].oldspeak = lines[c][i];
+                entries[e].categories = insert_set(c, empty_set());
+                // the last word of a newspeak line is the newspeak
+                char *last = c == CATEGORY_NEWSPEAK ? strrchr(lines[c][i], ' ') : NULL;
+                if (last) {
+                    *last = '\0';
+                    entries[e].newspeak = last + 1;
+                }
+            }
+        }
+        for (size_t i = 0; i < count; i += 1) {
+            entries[i].words = count_words(entries[i].oldspeak);
+            phrases += entries[i].words > 1;
+        }
+        uint64_t size = ht_size(ht);
+        for (uint32_t t = 0; t < threads; t += 1) {
+            Loader *l = &loaders[t];
+            l->entries = entries;
+            l->count = count;
+            l->first = count * t / threads;
+            l->last = count * (t + 1) / threads;
+            l->low = size / threads * t + size % threads * t / threads;
+            l->high = size / threads * (t + 1) + size % threads * (t + 1) / threads;
+            l->fold = fold;
+            l->ht = ht;
+            l->bf = bf_scalable(bf) ? NULL : bf;
+            l->pf = pf;
+        }
+        run_threads(hash_slice, loaders, threads);
+    }
+
+    for (size_t i = 0; ok && bf_scalable(bf) && i < count; i += 1) {
+        // slices fill in order, so this part stays on one thread
+        if (entries[i].words == 1) {
+            bf_insert(bf, entries[i].oldspeak);
+        }
+    }
+
+    if (ok && phrases) {
+        // phrases get a small filter of their own, 16 bits per phrase
+        dict->phrases = bf_create(16 * phrases);
+        ok = dict->phrases != NULL;
+        for (size_t i = 0; ok && i < count; i += 1) {
+            if (entries[i].words > 1 && entries[i].words <= PHRASE_MAX) {
+                uint32_t words;
+                bf_insert_hash(dict->phrases, phrase_hash(entries[i].oldspeak, &words));
+                dict->phrase_lengths |= 1u << words;
+            }
+        }
+    }
+
+    if (ok) {
+        run_threads(insert_range, loaders, threads);
+    }
+    for (uint32_t t = 0; ok && t < threads; t += 1) {
+        branches += loaders[t].branches;
+        lookups += loaders[t].lookups;
+    }
+    // words made to pile into one tree get spread out under fresh salts
+    ok = ok && ht_balance(ht);
+    // the fuzzy index is small enough to build on one thread
+    for (size_t i = 0; ok && dict->fuzzy && i < count; i += 1) {
+        if (entries[i].words == 1) {
+            // the node has the categories of every file listing the word
+            Set all = entries[i].node ? entries[i].node->categories : entries[i].categories;
+            ok = fuzzy_insert(dict->fuzzy, entries[i].oldspeak, entries[i].newspeak, all);
+        }
+    }
+
+    // hot word caches drop what they cached during the load, once for the
+    // whole load rather than once per word
+    bf_publish(bf);
+    if (pf) {
+        pf_publish(pf);
+    }
+    ht_publish(ht);
+
+    // the nodes keep their own copies of the words
+    free(loaders);
+    free(entries);
+    for (uint32_t c = 0; c < categories && c < CATEGORY_MAX; c += 1) {
+        free(lines[c]);
+        free(texts[c]);
+    }
+    return ok;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "verdict.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool load_dictionary(
+    char **files, uint32_t categories, Dictionary *dict, bool fold, uint32_t threads);
@@ -0,0 +1,235 @@
+// Allocation layer for the big arrays (the bloom filter's bits and the hash
+// table's trees). Arrays of 2 MB or more are mapped with huge pages when
+// the system has them, falling back to transparent huge pages and then to
+// normal pages, and can be interleaved or bound across NUMA nodes. A
+// transparent huge page mapping is only a request, so the page size it
+// got is read back from /proc/self/smaps once it has been touched.
+#include "mem.h"
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#define HUGE_2MB ((size_t) 1 << 21)
+#define HUGE_1GB ((size_t) 1 << 30)
+
+// Linux mbind() modes, from <numaif.h> which we do not want to depend on
+#define MPOL_BIND       2
+#define MPOL_INTERLEAVE 3
+
+// Most nodes we will spread memory over
+#define MEM_MAX_NODES 64
+
+static MemPolicy policy = MEM_LOCAL;
+
+// The mem_set_policy() function picks the NUMA placement for big arrays
+// allocated from now on
+// Inputs: the policy
+// Outputs: void
+
+void mem_set_policy(MemPolicy p) {
+    policy = p;
+}
+
+// The mem_get_policy() function finds the NUMA placement in use
+// Inputs: void
+// Outputs: the policy
+
+MemPolicy mem_get_policy(void) {
+    return policy;
+}
+
+// The online_nodes() function reads which NUMA nodes are online
+// Inputs: void
+// Outputs: a bit mask of the online nodes (node 0 if it cannot tell)
+
+static uint64_t online_nodes(void) {
+    uint64_t mask = 0;
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    if (f) {
+        // the list looks like 0-3,5
+        unsigned first, last;
+        int got;
+        while ((got = fscanf(f, "%u-%u", &first, &last)) >= 1) {
+            if (got == 1) {
+                last = first;
+            }
+            for (unsigned n = first; n <= last && n < MEM_MAX_NODES; n += 1) {
+                mask |= (uint64_t) 1 << n;
+            }
+            if (fgetc(f) != ',') {
+                break;
+            }
+        }
+        fclose(f);
+    }
+    return mask ? mask : 1;
+}
+
+// The mem_nodes() function counts the NUMA nodes
+// Inputs: void
+// Outputs: one more than the highest online node
+
+uint32_t mem_nodes(void) {
+    uint64_t mask = online_nodes();
+    uint32_t count = 0;
+    while (mask) {
+        count += 1;
+        mask >>= 1;
+    }
+    return count;
+}
+
+// The mem_node() function finds the NUMA node the calling thread runs on
+// Inputs: void
+// Outputs: the node
+
+uint32_t mem_node(void) {
+#ifdef __linux__
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0 && node < MEM_MAX_NODES) {
+        return node;
+    }
+#endif
+    return 0;
+}
+
+// The mem_alloc() function allocates a zeroed array
+// Inputs: how many bytes, the node to put it on (-1 follows the policy),
+// where to store the page size actually used
+// Outputs: a pointer to the array, or null
+
+void *mem_alloc(size_t bytes, int node, size_t *page) {
+    *page = (size_t) sysconf(_SC_PAGESIZE);
+    if (bytes > SIZE_MAX - HUGE_1GB - HUGE_2MB) {
+        // rounding up to whole pages would wrap around
+        return NULL;
+    }
+#ifdef __linux__
+    if (bytes >= HUGE_2MB) {
+        void *p = MAP_FAILED;
+        // try reserved huge pages, 1 GB ones if the array is that big
+        if (bytes >= HUGE_1GB) {
+            size_t size = (bytes + HUGE_1GB - 1) & ~(HUGE_1GB - 1);
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+            if (p != MAP_FAILED) {
+                *page = HUGE_1GB;
+            }
+        }
+        if (p == MAP_FAILED) {
+            size_t size = (bytes + HUGE_2MB - 1) & ~(HUGE_2MB - 1);
+            p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+            if (p != MAP_FAILED) {
+                *page = HUGE_2MB;
+            }
+        }
+        if (p == MAP_FAILED) {
+            // no reserved huge pages, ask for transparent ones. Only 2 MB
+            // aligned ranges can get them, so map 2 MB more than needed and
+            // trim the ends off
+            size_t size = (bytes + HUGE_2MB - 1) & ~(HUGE_2MB - 1);
+            char *m = (char *) mmap(
+                NULL, size + HUGE_2MB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (m == (char *) MAP_FAILED) {
+                return NULL;
+            }
+            char *start = (char *) (((uintptr_t) m + HUGE_2MB - 1) & ~(uintptr_t) (HUGE_2MB - 1));
+            if (start > m) {
+                munmap(m, (size_t) (start - m));
+            }
+            munmap(start + size, HUGE_2MB - (size_t) (start - m));
+            p = start;
+            // the page size stays the normal one, mem_page_size() finds
+            // out what the hint got
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+        // place the pages before anything touches them
+        uint64_t nodes = online_nodes();
+        if (node >= 0 && node < MEM_MAX_NODES) {
+            uint64_t mask = (uint64_t) 1 << node;
+            syscall(SYS_mbind, p, bytes, MPOL_BIND, &mask, MEM_MAX_NODES + 1, 0);
+        } else if (policy != MEM_LOCAL && (nodes & (nodes - 1))) {
+            syscall(SYS_mbind, p, bytes, MPOL_INTERLEAVE, &nodes, MEM_MAX_NODES + 1, 0);
+        }
+        return p;
+    }
+#else
+    (void) node;
+#endif
+    return calloc(bytes, 1);
+}
+
+// The mem_page_size() function finds the page size an array from
+// mem_alloc() got. Reserved huge pages are known when mapped; a mapping
+// with normal pages may have got transparent huge pages, which shows in
+// its AnonHugePages once it is touched, and only counts if all of it did
+// Inputs: the array, how many bytes were asked for, the page size
+// mem_alloc() gave
+// Outputs: the page size in bytes
+
+size_t mem_page_size(void *p, size_t bytes, size_t page) {
+#ifdef __linux__
+    if (!p || bytes < HUGE_2MB || page != (size_t) sysconf(_SC_PAGESIZE)) {
+        return page;
+    }
+    FILE *f = fopen("/proc/self/smaps", "r");
+    if (!f) {
+        return page;
+    }
+    // find the mapping holding the array, then its Rss and AnonHugePages
+    char line[256];
+    bool inside = false;
+    unsigned long rss = 0, huge = 0, kb;
+    while (fgets(line, sizeof(line), f)) {
+        uintptr_t first, last;
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " ", &first, &last) == 2) {
+            if (inside) {
+                break; // past the mapping
+            }
+            inside = first <= (uintptr_t) p && (uintptr_t) p < last;
+        } else if (inside && sscanf(line, "Rss: %lu kB", &kb) == 1) {
+            rss = kb;
+        } else if (inside && sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) {
+            huge = kb;
+        }
+    }
+    fclose(f);
+    return rss && huge == rss ? HUGE_2MB : page;
+#else
+    (void) p;
+    (void) bytes;
+    return page;
+#endif
+}
+
+// The mem_free() function frees an array from mem_alloc()
+// Inputs: the array, how many bytes were asked for, the page size used
+// Outputs: void
+
+void mem_free(void *p, size_t bytes, size_t page) {
+    if (!p) {
+        return;
+    }
+#ifdef __linux__
+    if (bytes >= HUGE_2MB) {
+        // mappings were rounded up to whole huge pages
+        size_t unit = page == HUGE_1GB ? HUGE_1GB : HUGE_2MB;
+        munmap(p, (bytes + unit - 1) & ~(unit - 1));
+        return;
+    }
+#else
+    (void) bytes;
+    (void) page;
+#endif
+    free(p);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// How big arrays are placed across NUMA nodes
+// MEM_LOCAL = wherever the kernel puts them (first touch)
+// MEM_INTERLEAVE = pages spread round robin over every node
+// MEM_REPLICATE = interleaved, and the bloom filter gets a copy on every
+// node for the threads running there
+typedef enum { MEM_LOCAL, MEM_INTERLEAVE, MEM_REPLICATE } MemPolicy;
+
+void mem_set_policy(MemPolicy policy);
+
+MemPolicy mem_get_policy(void);
+
+void *mem_alloc(size_t bytes, int node, size_t *page);
+
+size_t mem_page_size(void *p, size_t bytes, size_t page);
+
+void mem_free(void *p, size_t bytes, size_t page);
+
+uint32_t mem_nodes(void);
+
+uint32_t mem_node(void);
@@ -4,18 +4,65 @@
 #include <stdio.h>
 #include <string.h>
 
+// The node_prefix() function packs the first 8 bytes of a key into an
+// integer, most significant byte first and zero padded
+// Inputs: the key and its length
+// Outputs: the packed prefix, which orders the same way as strcmp()
+
+uint64_t node_prefix(const char *key, uint32_t length) {
+    uint64_t prefix = 0;
+    for (uint32_t i = 0; i < 8; i += 1) {
+        prefix <<= 8;
+        if (i < length) {
+            prefix |= (uint8_t) key[i];
+        }
+    }
+    return prefix;
+}
+
+// The node_compare() function compares the oldspeak in a node against a key
+// Inputs: a pointer to a node, the key's prefix, the key and its length
+// Outputs: a value greater than, equal to, or less than 0 like strcmp()
+// would give for (n->oldspeak, key)
+
+int node_compare(Node *n, uint64_t prefix, const char *key, uint32_t length) {
+    if (n->prefix != prefix) {
+        // most words are told apart without touching the key bytes
+        return n->prefix > prefix ? 1 : -1;
+    }
+    uint32_t shortest = n->length < length ? n->length : length;
+    if (shortest > 8) {
+        // same first 8 bytes, compare the rest once
+        int diff = memcmp(n->oldspeak + 8, key + 8, shortest - 8);
+        if (diff) {
+            return diff;
+        }
+    }
+    // one is a prefix of the other, the shorter one comes first
+    return (n->length > length) - (n->length < length);
+}
+
 // The node_create() function constructs the node
 // Inputs: oldspeak and newspeak
 // Outputs: a pointer to the node
 
 Node *node_create(char *oldspeak, char *newspeak) {
-    Node *n = (Node *) calloc(1, sizeof(Node));
+    // align to a cache line so each node costs one miss to visit
+    Node *n = (Node *) aligned_alloc(64, sizeof(Node));
+    if (!n) {
+        return NULL;
+    }
+    memset(n, 0, sizeof(Node));
     if (oldspeak) {
-        // oldspeak is not null, we can do strdup
-        n->oldspeak = strdup(oldspeak);
-        if (!(n->oldspeak)) { // just in case something went wrong with strdup
-            free(n->oldspeak);
-            n->oldspeak = NULL;
+        n->length = (uint32_t) strlen(oldspeak);
+        n->prefix = node_prefix(oldspeak, n->length);
+        if (n->length < NODE_INLINE) {
+            // short word, keep it inside the node
+            memcpy(n->key, oldspeak, n->length + 1);
+            n->oldspeak = n->key;
+        } else {
+            // oldspeak is too long to inline, we can do strdup
+            n->oldspeak = strdup(oldspeak);
         }
     } else {
         // oldspeak is null
@@ -25,10 +72,6 @@ Node *node_create(char *oldspeak, char *newspeak) {
     if (newspeak) {
         // newspeak is not null, we can do strdup
         n->newspeak = strdup(newspeak);
-        if (!(n->newspeak)) { // just in case something went wrong with strdup
-            free(n->newspeak);
-            n->newspeak = NULL;
-        }
     } else {
         // newspeak is null
         n->newspeak = NULL;
@@ -42,7 +85,8 @@ Node *node_create(char *oldspeak, char *newspeak) {
 // Outputs: void
 
 void node_delete(Node **n) {
-    if ((*n)->oldspeak) {
+    if ((*n)->oldspeak && (*n)->oldspeak != (*n)->key) {
+        // only long words were allocated separately
         free((*n)->oldspeak);
     }
     if ((*n)->newspeak) {
@@ -1,12 +1,30 @@
 #pragma once
 
+#include "set.h"
+
+#include <stdint.h>
+
+// Keys shorter than this many bytes are stored inside the node itself
+#define NODE_INLINE 12
+
 typedef struct Node Node;
 
+// prefix = first 8 bytes of oldspeak packed big-endian, so comparing
+// prefixes orders nodes the same way strcmp() would
+// length = length of oldspeak in bytes
+// oldspeak points at key when the word is short enough to be inlined
+// categories = the dictionary categories the word was listed in
+// Laid out to fill exactly one 64 byte cache line
+
 struct Node {
-    char *oldspeak;
-    char *newspeak;
+    uint64_t prefix;
+    uint32_t length;
+    char key[NODE_INLINE];
+    Set categories;
     Node *left;
     Node *right;
+    char *oldspeak;
+    char *newspeak;
 };
 
 Node *node_create(char *oldspeak, char *newspeak);
@@ -14,3 +32,7 @@ Node *node_create(char *oldspeak, char *newspeak);
 void node_delete(Node **n);
 
 void node_print(Node *n);
+
+uint64_t node_prefix(const char *key, uint32_t length);
+
+int node_compare(Node *n, uint64_t prefix, const char *key, uint32_t length);
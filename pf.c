@@ -0,0 +1,145 @@
+// Tier-zero prefilter that sits in front of the bloom filter. It only
+// remembers which word lengths and which leading bigrams appear in the
+// dictionary, so it can turn most clean words away without hashing them.
+#include "pf.h"
+#include "salts.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Words this long or longer all share the last length bit
+#define PF_LENGTHS 256
+
+// Structure for Prefilter
+// lengths = one bit per word length seen in the dictionary
+// bigrams = one bit per first-two-byte pair seen in the dictionary
+// generation = unique to this prefilter, drawn again when inserts are
+// published, not part of an image
+
+struct Prefilter {
+    uint64_t lengths[PF_LENGTHS / 64];
+    uint64_t bigrams[65536 / 64];
+    uint64_t generation;
+};
+
+// Size of a prefilter image, the bitmaps only
+#define PF_IMAGE offsetof(Prefilter, generation)
+
+// The pf_length() function finds the length bit used for a word
+// Inputs: the word
+// Outputs: the index of its bit in the length bitmap
+
+static inline uint32_t pf_length(const char *word) {
+    size_t length = strlen(word);
+    return length < PF_LENGTHS ? (uint32_t) length : PF_LENGTHS - 1;
+}
+
+// The pf_bigram() function finds the bigram bit used for a word
+// Inputs: the word
+// Outputs: the index of its bit in the bigram bitmap, a one letter
+// word uses 0 as its second byte
+
+static inline uint32_t pf_bigram(const char *word) {
+    uint32_t first = (uint8_t) word[0];
+    uint32_t second = first ? (uint8_t) word[1] : 0;
+    return (first << 8) | second;
+}
+
+// The pf_create() function constructs an empty prefilter
+// Inputs: void
+// Outputs: a pointer to the prefilter
+
+Prefilter *pf_create(void) {
+    Prefilter *pf = (Prefilter *) calloc(1, sizeof(Prefilter));
+    if (pf) {
+        pf->generation = salts_generation();
+    }
+    return pf;
+}
+
+// The pf_delete() function destructs the prefilter
+// Inputs: a pointer to a pointer to the prefilter
+// Outputs: void
+
+void pf_delete(Prefilter **pf) {
+    if (*pf) {
+        free(*pf);
+        *pf = NULL;
+    }
+    return;
+}
+
+// The pf_insert() function records a dictionary word in the prefilter
+// Inputs: a pointer to the prefilter, the oldspeak to be inserted
+// Outputs: void
+
+void pf_insert(Prefilter *pf, char *oldspeak) {
+    uint32_t length = pf_length(oldspeak);
+    uint32_t bigram = pf_bigram(oldspeak);
+    // atomic, so words can be added while other threads probe
+    __atomic_fetch_or(&pf->lengths[length / 64], (uint64_t) 0x1 << length % 64, __ATOMIC_RELAXED);
+    __atomic_fetch_or(&pf->bigrams[bigram / 64], (uint64_t) 0x1 << bigram % 64, __ATOMIC_RELAXED);
+    return;
+}
+
+// The pf_publish() function draws a new generation once a batch of
+// inserts is done, so answers cached before them are dropped. A probe
+// that sees the new generation sees the bits too
+// Inputs: a pointer to the prefilter
+// Outputs: void
+
+void pf_publish(Prefilter *pf) {
+    __atomic_store_n(&pf->generation, salts_generation(), __ATOMIC_RELEASE);
+    return;
+}
+
+// The pf_generation() function gives a number that no other prefilter, and
+// no other set of words of this prefilter, has had
+// Inputs: a pointer to the prefilter
+// Outputs: the generation
+
+uint64_t pf_generation(Prefilter *pf) {
+    return __atomic_load_n(&pf->generation, __ATOMIC_ACQUIRE);
+}
+
+// The pf_probe() function checks if a word could be in the dictionary
+// Inputs: a pointer to the prefilter, the oldspeak we are looking for
+// Outputs: false if the word is definitely not in the dictionary, true
+// if it has to be checked against the bloom filter
+
+bool pf_probe(Prefilter *pf, char *oldspeak) {
+    uint32_t length = pf_length(oldspeak);
+    uint32_t bigram = pf_bigram(oldspeak);
+    return ((__atomic_load_n(&pf->lengths[length / 64], __ATOMIC_RELAXED) >> length % 64) & 0x1)
+           && ((__atomic_load_n(&pf->bigrams[bigram / 64], __ATOMIC_RELAXED) >> bigram % 64)
+               & 0x1);
+}
+
+// The pf_export() function writes the prefilter as an image for a shared
+// segment, it has no pointers so the image is the prefilter's bitmaps
+// Inputs: a pointer to the prefilter, where the image goes (null to only
+// find its size)
+// Outputs: the size of the image in bytes
+
+uint64_t pf_export(Prefilter *pf, void *to) {
+    if (to) {
+        memcpy(to, pf, PF_IMAGE);
+    }
+    return PF_IMAGE;
+}
+
+// The pf_attach() function makes a prefilter from an image. It is a few
+// KB, so it is copied rather than shared
+// Inputs: the image from pf_export()
+// Outputs: a pointer to the prefilter, or null if memory ran out
+
+Prefilter *pf_attach(const void *image) {
+    Prefilter *pf = (Prefilter *) malloc(sizeof(Prefilter));
+    if (pf) {
+        memcpy(pf, image, PF_IMAGE);
+        pf->generation = salts_generation();
+    }
+    return pf;
+}
+
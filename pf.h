@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Prefilter Prefilter;
+
+Prefilter *pf_create(void);
+
+void pf_delete(Prefilter **pf);
+
+void pf_insert(Prefilter *pf, char *oldspeak);
+
+bool pf_probe(Prefilter *pf, char *oldspeak);
+
+void pf_publish(Prefilter *pf);
+
+uint64_t pf_generation(Prefilter *pf);
+
+uint64_t pf_export(Prefilter *pf, void *to);
+
+Prefilter *pf_attach(const void *image);
@@ -0,0 +1,133 @@
+// Phrase matching over the word stream. Every word gets a cheap 64-bit
+// hash, and the hash of the last n words is a polynomial in those hashes,
+// h(w1) * P^(n-1) + ... + h(wn). The window keeps rolling prefix hashes of
+// the whole stream, H(i+1) = H(i) * P + h(wi), one multiply-add per word,
+// so the phrase from word i up to word j is H(j) - H(i) * P^(j-i), one
+// multiply and subtract for each phrase length ending at the current
+// word. Only the few that pass the phrase bloom filter are joined into a
+// string and checked in the hash table.
+#include "phrase.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Base of the polynomial
+#define PHRASE_BASE 0x100000001b3ULL
+
+// PHRASE_BASE to the power of 0 up to PHRASE_MAX, wrapping like the hashes
+static const uint64_t powers[PHRASE_MAX + 1] = { 1, PHRASE_BASE, PHRASE_BASE * PHRASE_BASE,
+    PHRASE_BASE * PHRASE_BASE * PHRASE_BASE, PHRASE_BASE * PHRASE_BASE * PHRASE_BASE * PHRASE_BASE,
+    PHRASE_BASE * PHRASE_BASE * PHRASE_BASE * PHRASE_BASE * PHRASE_BASE };
+
+// The phrase_token_hash() function hashes one word (FNV-1a, then mixed)
+// Inputs: the word and its length
+// Outputs: the 64-bit hash
+
+uint64_t phrase_token_hash(const char *token, size_t length) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < length; i += 1) {
+        h ^= (uint8_t) token[i];
+        h *= 0x100000001b3ULL;
+    }
+    // spread the bits so the polynomial does not cancel them out
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// The phrase_hash() function hashes a whole phrase the same way the
+// window does
+// Inputs: the phrase, words separated by single spaces, and where to
+// store how many words it has
+// Outputs: the 64-bit hash
+
+uint64_t phrase_hash(const char *phrase, uint32_t *words) {
+    uint64_t h = 0;
+    *words = 0;
+    while (*phrase) {
+        const char *end = strchr(phrase, ' ');
+        size_t length = end ? (size_t) (end - phrase) : strlen(phrase);
+        h = h * PHRASE_BASE + phrase_token_hash(phrase, length);
+        *words += 1;
+        phrase += length + (end != NULL);
+    }
+    return h;
+}
+
+// The window_push() function adds a word to the window, dropping the
+// oldest word if it is full
+// Inputs: a pointer to the window, the word
+// Outputs: false if memory ran out
+
+bool window_push(Window *w, const char *word) {
+    uint32_t slot = (w->start + w->count) % PHRASE_MAX;
+    if (w->count == PHRASE_MAX) {
+        // the oldest word's slot is reused
+        slot = w->start;
+        w->start = (w->start + 1) % PHRASE_MAX;
+    } else {
+        w->count += 1;
+    }
+    size_t length = strlen(word);
+    if (length + 1 > w->capacity[slot]) {
+        char *bigger = (char *) realloc(w->tokens[slot], 2 * length + 1);
+        if (!bigger) {
+            w->count = 0;
+            return false;
+        }
+        w->tokens[slot] = bigger;
+        w->capacity[slot] = 2 * length + 1;
+    }
+    memcpy(w->tokens[slot], word, length + 1);
+    // roll the prefix hash on by one word
+    w->prefixes[slot] = w->total;
+    w->total = w->total * PHRASE_BASE + phrase_token_hash(word, length);
+    return true;
+}
+
+// The window_hash() function hashes the newest few words of the window
+// from the prefix hashes, without going over the words
+// Inputs: a pointer to the window, how many words (at most its count)
+// Outputs: the hash phrase_hash() gives for those words
+
+uint64_t window_hash(Window *w, uint32_t words) {
+    uint64_t before = w->prefixes[(w->start + w->count - words) % PHRASE_MAX];
+    return w->total - before * powers[words];
+}
+
+// The window_join() function writes the newest few words of the window
+// as a phrase
+// Inputs: a pointer to the window, how many words, a buffer and its size
+// Outputs: the buffer, or null if the phrase does not fit
+
+char *window_join(Window *w, uint32_t words, char *buffer, size_t size) {
+    size_t used = 0;
+    for (uint32_t i = w->count - words; i < w->count; i += 1) {
+        const char *token = w->tokens[(w->start + i) % PHRASE_MAX];
+        size_t length = strlen(token);
+        if (used + length + 1 > size) {
+            return NULL;
+        }
+        memcpy(buffer + used, token, length);
+        used += length;
+        buffer[used++] = ' ';
+    }
+    buffer[used - 1] = '\0'; // last space becomes the end
+    return buffer;
+}
+
+// The window_delete() function frees the window's words
+// Inputs: a pointer to the window
+// Outputs: void
+
+void window_delete(Window *w) {
+    for (uint32_t i = 0; i < PHRASE_MAX; i += 1) {
+        free(w->tokens[i]);
+        w->tokens[i] = NULL;
+        w->capacity[i] = 0;
+    }
+    w->count = 0;
+    w->total = 0;
+    return;
+}
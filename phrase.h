@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest phrase, in words
+#define PHRASE_MAX 5
+
+// Structure for the last few words seen, used to match phrases
+// tokens = copies of the words, oldest at start
+// capacity = size of each token buffer
+// prefixes = prefix hash of the stream just before each word
+// count = how many words are in the window (up to PHRASE_MAX)
+// start = index of the oldest word
+// total = prefix hash of the stream up to and with the newest word
+
+typedef struct {
+    char *tokens[PHRASE_MAX];
+    size_t capacity[PHRASE_MAX];
+    uint64_t prefixes[PHRASE_MAX];
+    uint32_t count;
+    uint32_t start;
+    uint64_t total;
+} Window;
+
+uint64_t phrase_token_hash(const char *token, size_t length);
+
+uint64_t phrase_hash(const char *phrase, uint32_t *words);
+
+bool window_push(Window *w, const char *word);
+
+uint64_t window_hash(Window *w, uint32_t words);
+
+char *window_join(Window *w, uint32_t words, char *buffer, size_t size);
+
+void window_delete(Window *w);
@@ -0,0 +1,473 @@
+// Pipelined mode for one input stream. A reader stage fills large blocks
+// (through io_uring when the kernel allows it, plain read() otherwise), a
+// tokenizer stage turns blocks into batches of folded words, and one or
+// more matcher stages check the words. Stages hand buffers to each other
+// over single-producer/single-consumer rings and hand them back empty over
+// a second ring, so a fixed set of buffers is recycled and no stage takes
+// a lock. A slow input pipe then only stalls the reader.
+#define _GNU_SOURCE
+#include "pipeline.h"
+#include "ring.h"
+#include "scanner.h"
+#include "uring.h"
+#include "utf8.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Size and number of the input blocks
+#define PIPE_BLOCK  (1 << 20)
+#define PIPE_BLOCKS 8
+
+// Size and number (per matcher) of the word batches
+#define PIPE_BATCH   65536
+#define PIPE_BATCHES 4
+
+// Structure for a block of input
+// data = the bytes, size of them read so far
+// offset = where in the file the block starts, -1 for a pipe
+// done = the read has finished
+// last = nothing comes after this block
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+    int64_t offset;
+    bool done;
+    bool last;
+} Block;
+
+// Structure for a batch of words
+// words = the words, each followed by a null byte
+// used, capacity = bytes used and room in words
+// last = the matcher stops after this batch
+
+typedef struct {
+    char *words;
+    size_t used;
+    size_t capacity;
+    bool last;
+} Tokens;
+
+// Structure for the whole pipeline, shared by the stages
+// fd = the input, ascii = only ASCII letters make words
+// dict = the dictionary the matchers check against
+// matchers = how many matcher stages run
+// blocks = the input blocks, passed on in filled and handed back in empty
+// tokens = the batches, PIPE_BATCHES for each matcher, passed on in
+// batches and handed back in spent
+// verdicts, counts = what each matcher found, and its branches and lookups
+// failed = the input could not be read
+
+typedef struct {
+    int fd;
+    bool ascii;
+    Dictionary *dict;
+    uint32_t matchers;
+    Block blocks[PIPE_BLOCKS];
+    Ring *filled;
+    Ring *empty;
+    Tokens *tokens;
+    Ring **batches;
+    Ring **spent;
+    Verdict *verdicts;
+    uint64_t (*counts)[2];
+    bool failed;
+} Pipeline;
+
+// Structure for what a matcher thread is given
+// p = the pipeline
+// id = which matcher this is
+
+typedef struct {
+    Pipeline *p;
+    uint32_t id;
+} Stage;
+
+// The read_plain() function is the reader stage when io_uring cannot be
+// used, one blocking read() per block
+// Inputs: the pipeline
+// Outputs: void
+
+static void read_plain(Pipeline *p) {
+    bool last = false;
+    while (!last) {
+        Block *b = (Block *) ring_take(p->empty);
+        ssize_t got;
+        do {
+            got = read(p->fd, b->data, PIPE_BLOCK);
+        } while (got < 0 && errno == EINTR);
+        p->failed = got < 0;
+        b->size = got > 0 ? (size_t) got : 0;
+        b->last = last = got <= 0;
+        ring_put(p->filled, b);
+    }
+    return;
+}
+
+// The submit() function queues the read that fills the rest of a block
+// Inputs: the pipeline, the io_uring, the block
+// Outputs: false if it could not be queued
+
+static bool submit(Pipeline *p, Uring *u, Block *b) {
+    int64_t offset = b->offset < 0 ? -1 : b->offset + (int64_t) b->size;
+    return uring_read(u, p->fd, b->data + b->size, PIPE_BLOCK - (uint32_t) b->size, offset,
+        (uint64_t) (b - p->blocks));
+}
+
+// The read_uring() function is the reader stage with io_uring. A file
+// gets several blocks read ahead at once, a pipe one at a time; blocks
+// are passed on in order whatever order the reads finish in
+// Inputs: the pipeline, the io_uring
+// Outputs: void
+
+static void read_uring(Pipeline *p, Uring *u) {
+    struct stat info;
+    bool file = !fstat(p->fd, &info) && S_ISREG(info.st_mode);
+    off_t start = file ? lseek(p->fd, 0, SEEK_CUR) : -1;
+    int64_t offset = start < 0 ? -1 : (int64_t) start;
+    uint32_t depth = offset < 0 ? 1 : PIPE_BLOCKS;
+    // queue = blocks being read, oldest first
+    Block *queue[PIPE_BLOCKS];
+    uint32_t first = 0, queued = 0;
+    bool end = false, finished = false;
+    while (!finished || queued) {
+        while (!end && queued < depth) {
+            Block *b = (Block *) (queued ? ring_pop(p->empty) : ring_take(p->empty));
+            if (!b) {
+                break;
+            }
+            b->size = 0;
+            b->offset = offset;
+            b->done = b->last = false;
+            if (!submit(p, u, b)) {
+                p->failed = b->done = b->last = end = true;
+            }
+            queue[(first + queued) % PIPE_BLOCKS] = b;
+            queued += 1;
+            offset = offset < 0 ? -1 : offset + PIPE_BLOCK;
+        }
+        if (queued && !queue[first]->done) {
+            uint64_t tag;
+            int32_t result;
+            if (!uring_wait(u, &tag, &result)) {
+                // nothing more can be known about the reads
+                p->failed = true;
+                tag = (uint64_t) (queue[first] - p->blocks);
+                result = 0;
+            }
+            Block *b = &p->blocks[tag];
+            if (result > 0) {
+                b->size += (size_t) result;
+                // a file block is only passed on full, a pipe takes what comes
+                b->done = b->offset < 0 || b->size == PIPE_BLOCK;
+            } else if (result != -EINTR && result != -EAGAIN) {
+                p->failed = p->failed || result < 0;
+                b->done = b->last = end = true;
+            }
+            if (!b->done && !submit(p, u, b)) {
+                p->failed = b->done = b->last = end = true;
+            }
+        }
+        while (queued && queue[first]->done) {
+            Block *b = queue[first];
+            first = (first + 1) % PIPE_BLOCKS;
+            queued -= 1;
+            if (!finished) {
+                // blocks read past the end are dropped
+                finished = b->last;
+                ring_put(p->filled, b);
+            }
+        }
+    }
+    return;
+}
+
+// The is_cut() function checks if a byte can never be part of a word, so
+// a block may be split after it
+// Inputs: the byte
+// Outputs: true if it can be split after
+
+static inline bool is_cut(uint8_t c) {
+    return c < 0x80 && !utf8_ascii_word[c];
+}
+
+// The emit() function passes a batch to its matcher and takes an empty
+// one from the next matcher
+// Inputs: the pipeline, the current batch, the current matcher
+// Outputs: void
+
+static void emit(Pipeline *p, Tokens **t, uint32_t *m) {
+    ring_put(p->batches[*m], *t);
+    *m = (*m + 1) % p->matchers;
+    *t = (Tokens *) ring_take(p->spent[*m]);
+    return;
+}
+
+// The tokenize() function adds the words in some bytes to the batches
+// Inputs: the pipeline, the bytes and how many, the current batch and
+// matcher
+// Outputs: void
+
+static void tokenize(Pipeline *p, const uint8_t *bytes, size_t size, Tokens **t, uint32_t *m) {
+    Scanner *s = size ? scanner_create_buffer((const char *) bytes, size, p->ascii) : NULL;
+    char *word;
+    while (s && (word = scanner_next(s)) != NULL) {
+        size_t length = strlen(word) + 1;
+        if ((*t)->used + length > (*t)->capacity && (*t)->used) {
+            emit(p, t, m);
+        }
+        if (length > (*t)->capacity) {
+            // a word longer than a batch, the batch keeps the extra room
+            char *words = (char *) realloc((*t)->words, length);
+            if (!words) {
+                perror("realloc");
+                exit(1);
+            }
+            (*t)->words = words;
+            (*t)->capacity = length;
+        }
+        memcpy((*t)->words + (*t)->used, word, length);
+        (*t)->used += length;
+    }
+    scanner_delete(&s);
+    return;
+}
+
+// The carry() function keeps bytes of a word that goes on in the next
+// block
+// Inputs: the carry buffer, its size and room, the bytes and how many
+// Outputs: void
+
+static void carry(
+    uint8_t **buffer, size_t *used, size_t *capacity, const uint8_t *bytes, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (*used + size > *capacity) {
+        *capacity = 2 * (*used + size);
+        uint8_t *bigger = (uint8_t *) realloc(*buffer, *capacity);
+        if (!bigger) {
+            perror("realloc");
+            exit(1);
+        }
+        *buffer = bigger;
+    }
+    memcpy(*buffer + *used, bytes, size);
+    *used += size;
+    return;
+}
+
+// The tokenizer() function is the tokenizer stage, blocks are split after
+// their last non-word byte and the rest is carried to the next block
+// Inputs: the pipeline
+// Outputs: null
+
+static void *tokenizer(void *arg) {
+    Pipeline *p = (Pipeline *) arg;
+    uint8_t *held = NULL;
+    size_t used = 0, capacity = 0;
+    uint32_t m = 0;
+    Tokens *t = (Tokens *) ring_take(p->spent[0]);
+    bool last = false;
+    while (!last) {
+        Block *b = (Block *) ring_take(p->filled);
+        last = b->last;
+        size_t start = 0, end = b->size;
+        while (!last && end > 0 && !is_cut(b->data[end - 1])) {
+            end -= 1;
+        }
+        if (used) {
+            // finish the word the last block ended in
+            while (start < b->size && !is_cut(b->data[start])) {
+                start += 1;
+            }
+            carry(&held, &used, &capacity, b->data, start);
+            if (start < b->size || last) {
+                tokenize(p, held, used, &t, &m);
+                used = 0;
+            }
+        }
+        if (start < end) {
+            tokenize(p, b->data + start, end - start, &t, &m);
+        }
+        if (end > start) {
+            carry(&held, &used, &capacity, b->data + end, b->size - end);
+        } else if (start < b->size) {
+            carry(&held, &used, &capacity, b->data + start, b->size - start);
+        }
+        ring_put(p->empty, b);
+    }
+    // every matcher gets a last batch, the current one goes first
+    for (uint32_t i = 0; i < p->matchers; i += 1) {
+        t->last = true;
+        ring_put(p->batches[m], t);
+        m = (m + 1) % p->matchers;
+        t = i + 1 < p->matchers ? (Tokens *) ring_take(p->spent[m]) : NULL;
+    }
+    free(held);
+    return NULL;
+}
+
+// The matcher() function is a matcher stage
+// Inputs: the stage
+// Outputs: null
+
+static void *matcher(void *arg) {
+    Stage *stage = (Stage *) arg;
+    Pipeline *p = stage->p;
+    Verdict *v = &p->verdicts[stage->id];
+    // probe the bloom filter copy closest to this thread
+    Dictionary local = dictionary_local(p->dict);
+    uint64_t branches_before = branches;
+    uint64_t lookups_before = lookups;
+    bool last = false;
+    while (!last) {
+        Tokens *t = (Tokens *) ring_take(p->batches[stage->id]);
+        for (size_t i = 0; i < t->used;) {
+            char *word = t->words + i;
+            i += strlen(word) + 1;
+            verdict_check(v, &local, word);
+        }
+        last = t->last;
+        t->used = 0;
+        t->last = false;
+        ring_put(p->spent[stage->id], t);
+    }
+    p->counts[stage->id][0] += branches - branches_before;
+    p->counts[stage->id][1] += lookups - lookups_before;
+    return NULL;
+}
+
+// The pin() function sets up a thread to run on one core
+// Inputs: the thread attributes, the stage number
+// Outputs: void
+
+static void pin(pthread_attr_t *attr, uint32_t stage) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(stage % (uint32_t) (cores > 0 ? cores : 1), &set);
+    pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+    return;
+}
+
+// The pipeline_run() function checks one input stream with the reader,
+// tokenizer and matchers each on their own thread
+// Inputs: the input, the dictionary, how many matchers, whether only
+// ASCII letters make words, where to add the findings
+// Outputs: true if all of the input was read and checked
+
+bool pipeline_run(int fd, Dictionary *dict, uint32_t matchers, bool ascii, Verdict *total) {
+    Pipeline p;
+    memset(&p, 0, sizeof(p));
+    p.fd = fd;
+    p.ascii = ascii;
+    p.dict = dict;
+    p.filled = ring_create(PIPE_BLOCKS);
+    p.empty = ring_create(PIPE_BLOCKS);
+    p.tokens = (Tokens *) calloc((size_t) matchers * PIPE_BATCHES, sizeof(Tokens));
+    p.batches = (Ring **) calloc(matchers, sizeof(Ring *));
+    p.spent = (Ring **) calloc(matchers, sizeof(Ring *));
+    p.verdicts = (Verdict *) calloc(matchers, sizeof(Verdict));
+    p.counts = calloc(matchers, sizeof(*p.counts));
+    Stage *stages = (Stage *) calloc(matchers, sizeof(Stage));
+    pthread_t *ids = (pthread_t *) calloc(matchers + 1, sizeof(pthread_t));
+    bool ok = p.filled && p.empty && p.tokens && p.batches && p.spent && p.verdicts && p.counts
+              && stages && ids;
+    for (uint32_t i = 0; ok && i < PIPE_BLOCKS; i += 1) {
+        p.blocks[i].data = (uint8_t *) malloc(PIPE_BLOCK);
+        ok = p.blocks[i].data && ring_push(p.empty, &p.blocks[i]);
+    }
+    for (uint32_t m = 0; ok && m < matchers; m += 1) {
+        p.batches[m] = ring_create(PIPE_BATCHES);
+        p.spent[m] = ring_create(PIPE_BATCHES);
+        ok = p.batches[m] && p.spent[m];
+        for (uint32_t i = 0; ok && i < PIPE_BATCHES; i += 1) {
+            Tokens *t = &p.tokens[m * PIPE_BATCHES + i];
+            t->words = (char *) malloc(PIPE_BATCH);
+            t->capacity = PIPE_BATCH;
+            ok = t->words && ring_push(p.spent[m], t);
+        }
+    }
+
+    // matchers first, the tokenizer hands out batches to as many as started
+    pthread_attr_t attr;
+    uint32_t started = 0;
+    bool tokenizing = false;
+    if (ok && !pthread_attr_init(&attr)) {
+        for (; started < matchers; started += 1) {
+            stages[started].p = &p;
+            stages[started].id = started;
+            pin(&attr, started + 2);
+            if (pthread_create(&ids[started + 1], &attr, matcher, &stages[started])) {
+                break;
+            }
+        }
+        p.matchers = started;
+        pin(&attr, 1);
+        tokenizing = started && !pthread_create(&ids[0], &attr, tokenizer, &p);
+        pthread_attr_destroy(&attr);
+    }
+    if (tokenizing) {
+        // the calling thread is the reader
+        Uring *u = uring_create(PIPE_BLOCKS);
+        if (u) {
+            read_uring(&p, u);
+        } else {
+            read_plain(&p);
+        }
+        uring_delete(&u);
+        pthread_join(ids[0], NULL);
+    } else {
+        // stop whatever matchers did start
+        for (uint32_t m = 0; m < started; m += 1) {
+            Tokens *t = (Tokens *) ring_take(p.spent[m]);
+            t->last = true;
+            ring_put(p.batches[m], t);
+        }
+    }
+    uint64_t branches_before = branches;
+    uint64_t lookups_before = lookups;
+    for (uint32_t m = 0; m < started; m += 1) {
+        pthread_join(ids[m + 1], NULL);
+        verdict_merge(total, &p.verdicts[m]);
+    }
+    // merging is not matching, only the workers' counts are added
+    branches = branches_before;
+    lookups = lookups_before;
+    for (uint32_t m = 0; m < started; m += 1) {
+        branches += p.counts[m][0];
+        lookups += p.counts[m][1];
+    }
+
+    for (uint32_t m = 0; p.verdicts && m < matchers; m += 1) {
+        verdict_delete(&p.verdicts[m]);
+    }
+    for (uint32_t m = 0; p.batches && p.spent && m < matchers; m += 1) {
+        ring_delete(&p.batches[m]);
+        ring_delete(&p.spent[m]);
+    }
+    for (uint32_t i = 0; p.tokens && i < matchers * PIPE_BATCHES; i += 1) {
+        free(p.tokens[i].words);
+    }
+    for (uint32_t i = 0; i < PIPE_BLOCKS; i += 1) {
+        free(p.blocks[i].data);
+    }
+    ring_delete(&p.filled);
+    ring_delete(&p.empty);
+    free(p.tokens);
+    free(p.batches);
+    free(p.spent);
+    free(p.verdicts);
+    free(p.counts);
+    free(stages);
+    free(ids);
+    return tokenizing && !p.failed;
+}
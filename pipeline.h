@@ -0,0 +1,8 @@
+#pragma once
+
+#include "verdict.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+bool pipeline_run(int fd, Dictionary *dict, uint32_t matchers, bool ascii, Verdict *total);
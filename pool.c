@@ -0,0 +1,123 @@
+// Work-stealing thread pool for a fixed list of tasks. Every worker starts
+// with its own run of tasks, takes them from the back, and when it runs
+// out it steals from the front of another worker's run.
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+
+// Structure for one worker's deque of tasks
+// lock = protects head and tail
+// head, tail = the tasks still waiting are head up to (not including) tail
+
+typedef struct {
+    pthread_mutex_t lock;
+    size_t head;
+    size_t tail;
+} Deque;
+
+// Structure for the pool shared by the workers
+// deques = one per worker
+// threads = number of workers
+// run, arg = what to call for each task
+
+typedef struct {
+    Deque *deques;
+    uint32_t threads;
+    void (*run)(size_t task, uint32_t worker, void *arg);
+    void *arg;
+} Pool;
+
+// Structure for what a worker thread is given
+// pool = the shared pool
+// id = which worker this is
+
+typedef struct {
+    Pool *pool;
+    uint32_t id;
+} Worker;
+
+// The pool_take() function takes a task, from the back of the worker's
+// own deque or the front of someone else's
+// Inputs: the pool, the worker, where to store the task
+// Outputs: true if a task was found
+
+static bool pool_take(Pool *pool, uint32_t id, size_t *task) {
+    for (uint32_t i = 0; i < pool->threads; i += 1) {
+        uint32_t victim = (id + i) % pool->threads;
+        Deque *d = &pool->deques[victim];
+        bool found = false;
+        pthread_mutex_lock(&d->lock);
+        if (d->head < d->tail) {
+            // own tasks come off the back, stolen ones off the front
+            *task = victim == id ? --d->tail : d->head++;
+            found = true;
+        }
+        pthread_mutex_unlock(&d->lock);
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The pool_worker() function runs tasks until there are none left
+// Inputs: a pointer to the Worker
+// Outputs: null
+
+static void *pool_worker(void *arg) {
+    Worker *w = (Worker *) arg;
+    size_t task;
+    while (pool_take(w->pool, w->id, &task)) {
+        w->pool->run(task, w->id, w->pool->arg);
+    }
+    return NULL;
+}
+
+// The pool_run() function runs tasks 0 to count - 1 across worker threads
+// and waits for all of them
+// Inputs: the number of threads, the number of tasks, the function to
+// run for each task and an argument passed to it
+// Outputs: true if every thread was started (tasks all run either way)
+
+bool pool_run(uint32_t threads, size_t count, void (*run)(size_t task, uint32_t worker, void *arg),
+    void *arg) {
+    Pool pool = { NULL, threads, run, arg };
+    pool.deques = (Deque *) calloc(threads, sizeof(Deque));
+    Worker *workers = (Worker *) calloc(threads, sizeof(Worker));
+    pthread_t *ids = (pthread_t *) calloc(threads, sizeof(pthread_t));
+    if (!pool.deques || !workers || !ids) {
+        free(pool.deques);
+        free(workers);
+        free(ids);
+        return false;
+    }
+    for (uint32_t t = 0; t < threads; t += 1) {
+        // hand out neighbouring tasks to the same worker
+        pthread_mutex_init(&pool.deques[t].lock, NULL);
+        pool.deques[t].head = count * t / threads;
+        pool.deques[t].tail = count * (t + 1) / threads;
+        workers[t].pool = &pool;
+        workers[t].id = t;
+    }
+    uint32_t started = 0;
+    for (; started < threads; started += 1) {
+        if (pthread_create(&ids[started], NULL, pool_worker, &workers[started])) {
+            break;
+        }
+    }
+    if (started == 0) {
+        // no threads at all, do the work here
+        pool_worker(&workers[0]);
+    }
+    for (uint32_t t = 0; t < started; t += 1) {
+        pthread_join(ids[t], NULL);
+    }
+    for (uint32_t t = 0; t < threads; t += 1) {
+        pthread_mutex_destroy(&pool.deques[t].lock);
+    }
+    free(pool.deques);
+    free(workers);
+    free(ids);
+    return started == threads;
+}
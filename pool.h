@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+bool pool_run(uint32_t threads, size_t count, void (*run)(size_t task, uint32_t worker, void *arg),
+    void *arg);
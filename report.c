@@ -0,0 +1,367 @@
+// Report writer. Reports are rendered into one reusable buffer and written
+// out with write() once the buffer is big enough, instead of one printf()
+// per word, so output is never what holds the filter back.
+#include "report.h"
+#include "messages.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Write the buffer out once it holds this much
+#define REPORT_FLUSH (1 << 16)
+
+// Structure for Report
+// fd = where the reports go
+// format = how they are rendered
+// lock = held while writing so reports from threads do not mix, may be null
+// buffer = rendered output not written yet, length bytes of capacity
+// ok = false once something failed
+// names, categories = the name of each dictionary category and how many
+
+struct Report {
+    int fd;
+    ReportFormat format;
+    pthread_mutex_t *lock;
+    char *buffer;
+    size_t length;
+    size_t capacity;
+    bool ok;
+    const char **names;
+    uint32_t categories;
+};
+
+// The report_create() function constructs a report writer
+// Inputs: the file descriptor to write to, the format, a lock shared
+// with other writers to the same descriptor (or null)
+// Outputs: a pointer to the report writer
+
+Report *report_create(int fd, ReportFormat format, pthread_mutex_t *lock) {
+    Report *r = (Report *) calloc(1, sizeof(Report));
+    if (r) {
+        r->fd = fd;
+        r->format = format;
+        r->lock = lock;
+        r->capacity = 2 * REPORT_FLUSH;
+        r->buffer = (char *) malloc(r->capacity);
+        r->ok = true;
+        if (!r->buffer) {
+            free(r);
+            r = NULL;
+        }
+    }
+    return r;
+}
+
+// The report_delete() function writes what is left and destructs the
+// report writer
+// Inputs: a pointer to a pointer to the report writer
+// Outputs: void
+
+void report_delete(Report **r) {
+    if (*r) {
+        report_flush(*r);
+        free((*r)->buffer);
+        free(*r);
+        *r = NULL;
+    }
+    return;
+}
+
+// The report_categories() function names the dictionary categories, so
+// reports can list the words found in each named category
+// Inputs: the report writer, the names in category order, how many
+// Outputs: void
+
+void report_categories(Report *r, const char **names, uint32_t categories) {
+    r->names = names;
+    r->categories = categories;
+    return;
+}
+
+// The put() function appends bytes to the buffer, growing it if needed
+// Inputs: the report writer, the bytes and how many
+// Outputs: void
+
+static void put(Report *r, const void *bytes, size_t length) {
+    if (r->length + length > r->capacity) {
+        size_t capacity = r->capacity;
+        while (r->length + length > capacity) {
+            capacity *= 2;
+        }
+        char *bigger = (char *) realloc(r->buffer, capacity);
+        if (!bigger) {
+            r->ok = false;
+            return;
+        }
+        r->buffer = bigger;
+        r->capacity = capacity;
+    }
+    memcpy(r->buffer + r->length, bytes, length);
+    r->length += length;
+    return;
+}
+
+// The put_string() function appends a null terminated string
+// Inputs: the report writer, the string
+// Outputs: void
+
+static void put_string(Report *r, const char *s) {
+    put(r, s, strlen(s));
+}
+
+// The put_u32() function appends a little endian 32 bit integer
+// Inputs: the report writer, the integer
+// Outputs: void
+
+static void put_u32(Report *r, uint32_t x) {
+    uint8_t bytes[4] = { x & 0xFF, (x >> 8) & 0xFF, (x >> 16) & 0xFF, (x >> 24) & 0xFF };
+    put(r, bytes, 4);
+}
+
+// The put_sized() function appends a string with its length in front
+// Inputs: the report writer, the string
+// Outputs: void
+
+static void put_sized(Report *r, const char *s) {
+    size_t length = strlen(s);
+    put_u32(r, (uint32_t) length);
+    put(r, s, length);
+}
+
+// The put_json() function appends a string as a quoted JSON string
+// Inputs: the report writer, the string
+// Outputs: void
+
+static void put_json(Report *r, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    put(r, "\"", 1);
+    const char *run = s;
+    for (; *s; s += 1) {
+        unsigned char c = (unsigned char) *s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue; // copied later with the rest of the run
+        }
+        put(r, run, (size_t) (s - run));
+        char escape[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+        if (c == '"' || c == '\\') {
+            escape[1] = (char) c;
+            put(r, escape, 2);
+        } else {
+            put(r, escape, 6);
+        }
+        run = s + 1;
+    }
+    put(r, run, (size_t) (s - run));
+    put(r, "\"", 1);
+}
+
+// The count_tree() function counts the nodes in a tree
+// Inputs: the root
+// Outputs: the number of nodes
+
+static uint32_t count_tree(Node *root) {
+    return root ? count_tree(root->left) + count_tree(root->right) + 1 : 0;
+}
+
+// The put_tree() function appends every word of a tree in order, the
+// way bst_print() would have printed them
+// Inputs: the report writer, the root, whether it is the first item of
+// a JSON list
+// Outputs: whether the next JSON item is still the first
+
+static bool put_tree(Report *r, Node *root, bool first) {
+    if (!root) {
+        return first;
+    }
+    first = put_tree(r, root->left, first);
+    switch (r->format) {
+    case REPORT_TEXT:
+        put_string(r, root->oldspeak);
+        if (root->newspeak) {
+            put(r, " -> ", 4);
+            put_string(r, root->newspeak);
+        }
+        put(r, "\n", 1);
+        break;
+    case REPORT_JSON:
+        if (!first) {
+            put(r, ",", 1);
+        }
+        if (root->newspeak) {
+            put(r, "{\"oldspeak\":", 12);
+            put_json(r, root->oldspeak);
+            put(r, ",\"newspeak\":", 12);
+            put_json(r, root->newspeak);
+            put(r, "}", 1);
+        } else {
+            put_json(r, root->oldspeak);
+        }
+        break;
+    case REPORT_BINARY:
+        put_sized(r, root->oldspeak);
+        if (root->newspeak) {
+            put_sized(r, root->newspeak);
+        }
+        break;
+    }
+    return put_tree(r, root->right, false);
+}
+
+// The put_category() function appends the words of a tree listed in one
+// category, in order
+// Inputs: the report writer, the root, the category, whether it is the
+// first item of a JSON list
+// Outputs: whether the next JSON item is still the first
+
+static bool put_category(Report *r, Node *root, uint32_t c, bool first) {
+    if (!root) {
+        return first;
+    }
+    first = put_category(r, root->left, c, first);
+    if (member_set(c, root->categories)) {
+        if (r->format == REPORT_JSON) {
+            put_string(r, first ? "" : ",");
+            put_json(r, root->oldspeak);
+        } else {
+            put_string(r, first ? " " : ", ");
+            put_string(r, root->oldspeak);
+        }
+        first = false;
+    }
+    return put_category(r, root->right, c, first);
+}
+
+// The put_categories() function appends the named categories a message
+// hit, each with its words from every list
+// Inputs: the report writer, the verdict
+// Outputs: void
+
+static void put_categories(Report *r, Verdict *v) {
+    bool first = true;
+    for (uint32_t c = CATEGORY_FIRST; c < r->categories; c += 1) {
+        if (!member_set(c, v->categories)) {
+            continue;
+        }
+        if (r->format == REPORT_JSON) {
+            put_string(r, first ? "" : ",");
+            put_json(r, r->names[c]);
+            put_string(r, ":[");
+        } else {
+            put_string(r, r->names[c]);
+            put_string(r, ":");
+        }
+        bool none = put_category(r, v->badwords_list, c, true);
+        none = put_category(r, v->badwords_list_with_newspeak, c, none);
+        put_category(r, v->categorized_list, c, none);
+        put_string(r, r->format == REPORT_JSON ? "]" : "\n");
+        first = false;
+    }
+    return;
+}
+
+// The report_verdict() function renders the report for one message
+// Inputs: the report writer, the name of the message (a file name, or
+// null for stdin), the verdict
+// Outputs: false if something went wrong writing
+
+bool report_verdict(Report *r, const char *name, Verdict *v) {
+    bool thoughtcrime = member_set(THOUGHTCRIME, v->punishment);
+    bool rightspeak = member_set(RIGHTSPEAK, v->punishment);
+    switch (r->format) {
+    case REPORT_TEXT:
+        if (name) {
+            put_string(r, "==> ");
+            put_string(r, name);
+            put_string(r, " <==\n");
+        }
+        // pick the letter for the crimes, nothing is printed if clean
+        if (thoughtcrime || rightspeak) {
+            put_string(r, thoughtcrime && rightspeak ? mixspeak_message
+                          : thoughtcrime             ? badspeak_message
+                                                     : goodspeak_message);
+            put_tree(r, v->badwords_list, true);
+            put_tree(r, v->badwords_list_with_newspeak, true);
+        }
+        // then a line per named category, nothing without them
+        put_categories(r, v);
+        break;
+    case REPORT_JSON:
+        put_string(r, "{\"file\":");
+        if (name) {
+            put_json(r, name);
+        } else {
+            put_string(r, "null");
+        }
+        put_string(r, ",\"verdict\":");
+        put_string(r, thoughtcrime && rightspeak ? "\"mixspeak\""
+                      : thoughtcrime             ? "\"badspeak\""
+                      : rightspeak               ? "\"goodspeak\""
+                                                 : "\"clean\"");
+        put_string(r, ",\"badspeak\":[");
+        put_tree(r, v->badwords_list, true);
+        put_string(r, "],\"oldspeak\":[");
+        put_tree(r, v->badwords_list_with_newspeak, true);
+        put_string(r, "]");
+        if (r->categories > CATEGORY_FIRST) {
+            put_string(r, ",\"categories\":{");
+            put_categories(r, v);
+            put_string(r, "}");
+        }
+        put_string(r, "}\n");
+        break;
+    case REPORT_BINARY: {
+        // the record length is filled in once the record is rendered
+        size_t start = r->length;
+        put_u32(r, 0);
+        uint8_t bits = (thoughtcrime ? 1 : 0) | (rightspeak ? 2 : 0);
+        put(r, &bits, 1);
+        put_sized(r, name ? name : "");
+        put_u32(r, count_tree(v->badwords_list));
+        put_tree(r, v->badwords_list, true);
+        put_u32(r, count_tree(v->badwords_list_with_newspeak));
+        put_tree(r, v->badwords_list_with_newspeak, true);
+        put_u32(r, count_tree(v->categorized_list));
+        put_tree(r, v->categorized_list, true);
+        put_u32(r, (uint32_t) v->categories);
+        put_u32(r, (uint32_t) (v->categories >> 32));
+        if (r->ok) {
+            uint32_t length = (uint32_t) (r->length - start - 4);
+            uint8_t bytes[4] = { length & 0xFF, (length >> 8) & 0xFF, (length >> 16) & 0xFF,
+                (length >> 24) & 0xFF };
+            memcpy(r->buffer + start, bytes, 4);
+        }
+        break;
+    }
+    }
+    if (r->length >= REPORT_FLUSH) {
+        return report_flush(r);
+    }
+    return r->ok;
+}
+
+// The report_flush() function writes out everything rendered so far
+// Inputs: the report writer
+// Outputs: false if something went wrong writing
+
+bool report_flush(Report *r) {
+    if (r->lock) {
+        pthread_mutex_lock(r->lock);
+    }
+    size_t done = 0;
+    while (r->ok && done < r->length) {
+        ssize_t wrote = write(r->fd, r->buffer + done, r->length - done);
+        if (wrote < 0 && errno != EINTR) {
+            r->ok = false;
+        } else if (wrote > 0) {
+            done += (size_t) wrote;
+        }
+    }
+    if (r->lock) {
+        pthread_mutex_unlock(r->lock);
+    }
+    r->length = 0;
+    return r->ok;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "verdict.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+// Output formats
+// REPORT_TEXT = the letter and word lists, same bytes as printf() gave
+// REPORT_JSON = one JSON object per message, one per line
+// REPORT_BINARY = one record per message, all integers little endian:
+//   u32 record length (not counting itself), u8 punishment bits
+//   (1 = thoughtcrime, 2 = rightspeak), u32 name length, name bytes,
+//   u32 badspeak count, then per word u32 length and bytes,
+//   u32 oldspeak count, then per pair u32 length, oldspeak bytes,
+//   u32 length, newspeak bytes, u32 count of words only in named
+//   categories, then per word u32 length and bytes, and last the u64
+//   category bits (bit n = category n, badspeak 0, newspeak 1)
+typedef enum { REPORT_TEXT, REPORT_JSON, REPORT_BINARY } ReportFormat;
+
+typedef struct Report Report;
+
+Report *report_create(int fd, ReportFormat format, pthread_mutex_t *lock);
+
+void report_delete(Report **r);
+
+void report_categories(Report *r, const char **names, uint32_t categories);
+
+bool report_verdict(Report *r, const char *name, Verdict *v);
+
+bool report_flush(Report *r);
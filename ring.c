@@ -0,0 +1,169 @@
+// Lock-free ring buffer for passing pointers from exactly one producer
+// thread to exactly one consumer thread. The producer only writes tail and
+// the consumer only writes head, each on its own cache line, so the two
+// never contend for a lock or a line except to see each other's progress.
+// A thread that still finds the ring empty (or full) after a short spin
+// sleeps on a futex until the other side moves, so an idle stage costs no
+// CPU.
+#include "ring.h"
+
+#include <linux/futex.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Number of empty checks before a waiting thread goes to sleep
+#define RING_SPIN 256
+
+// What a sleeping thread waits for, the consumer for an item and the
+// producer for a free slot
+typedef enum { RING_ITEM, RING_SLOT } Wait;
+
+// Structure for Ring
+// head = next slot to take, written by the consumer
+// tail = next slot to fill, written by the producer
+// mask = capacity - 1, the capacity is a power of 2
+// items = the slots
+// asleep = set by a thread about to sleep, one futex word per Wait
+
+struct Ring {
+    alignas(64) _Atomic uint64_t head;
+    alignas(64) _Atomic uint64_t tail;
+    alignas(64) uint64_t mask;
+    void **items;
+    alignas(64) _Atomic uint32_t asleep[2];
+};
+
+// The wake() function wakes the other side if it went to sleep, called
+// after head or tail moved
+// Inputs: a pointer to the ring, what the sleeper waits for
+// Outputs: void
+
+static void wake(Ring *r, Wait wait) {
+    // pairs with the fence in park(): either the sleeper sees the move or
+    // this sees its flag
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&r->asleep[wait], memory_order_relaxed)) {
+        atomic_store_explicit(&r->asleep[wait], 0, memory_order_relaxed);
+        syscall(SYS_futex, &r->asleep[wait], FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+    return;
+}
+
+// The park() function waits until the other side moves, or returns at
+// once if it already has
+// Inputs: a pointer to the ring, what to wait for
+// Outputs: void
+
+static void park(Ring *r, Wait wait) {
+    atomic_store_explicit(&r->asleep[wait], 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (wait == RING_ITEM ? head == tail : tail - head > r->mask) {
+        // sleeps only while the flag is still set, wake() clears it first
+        syscall(SYS_futex, &r->asleep[wait], FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+    }
+    return;
+}
+
+// The ring_create() function constructs an empty ring
+// Inputs: how many items it must hold, rounded up to a power of 2
+// Outputs: a pointer to the ring, or null if memory ran out
+
+Ring *ring_create(uint32_t capacity) {
+    Ring *r = (Ring *) aligned_alloc(64, sizeof(Ring));
+    if (r) {
+        uint64_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        atomic_init(&r->head, 0);
+        atomic_init(&r->tail, 0);
+        atomic_init(&r->asleep[RING_ITEM], 0);
+        atomic_init(&r->asleep[RING_SLOT], 0);
+        r->mask = size - 1;
+        r->items = (void **) calloc(size, sizeof(void *));
+        if (!r->items) {
+            free(r);
+            r = NULL;
+        }
+    }
+    return r;
+}
+
+// The ring_delete() function destructs the ring, not the items in it
+// Inputs: a pointer to a pointer to the ring
+// Outputs: void
+
+void ring_delete(Ring **r) {
+    if (*r) {
+        free((*r)->items);
+        free(*r);
+        *r = NULL;
+    }
+    return;
+}
+
+// The ring_push() function adds an item, called by the producer only
+// Inputs: a pointer to the ring, the item
+// Outputs: false if the ring is full
+
+bool ring_push(Ring *r, void *item) {
+    uint64_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&r->head, memory_order_acquire) > r->mask) {
+        return false;
+    }
+    r->items[tail & r->mask] = item;
+    // the item must be visible before the consumer sees the new tail
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    wake(r, RING_ITEM);
+    return true;
+}
+
+// The ring_pop() function takes the oldest item, called by the consumer
+// only
+// Inputs: a pointer to the ring
+// Outputs: the item, or null if the ring is empty
+
+void *ring_pop(Ring *r) {
+    uint64_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&r->tail, memory_order_acquire)) {
+        return NULL;
+    }
+    void *item = r->items[head & r->mask];
+    // the slot may be reused once the producer sees the new head
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    wake(r, RING_SLOT);
+    return item;
+}
+
+// The ring_put() function adds an item, waiting while the ring is full
+// Inputs: a pointer to the ring, the item
+// Outputs: void
+
+void ring_put(Ring *r, void *item) {
+    for (uint32_t spins = 0; !ring_push(r, item); spins += 1) {
+        if (spins >= RING_SPIN) {
+            park(r, RING_SLOT);
+        }
+    }
+    return;
+}
+
+// The ring_take() function takes the oldest item, waiting while the ring
+// is empty
+// Inputs: a pointer to the ring
+// Outputs: the item
+
+void *ring_take(Ring *r) {
+    void *item;
+    for (uint32_t spins = 0; (item = ring_pop(r)) == NULL; spins += 1) {
+        if (spins >= RING_SPIN) {
+            park(r, RING_ITEM);
+        }
+    }
+    return item;
+}
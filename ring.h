@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Ring Ring;
+
+Ring *ring_create(uint32_t capacity);
+
+void ring_delete(Ring **r);
+
+bool ring_push(Ring *r, void *item);
+
+void *ring_pop(Ring *r);
+
+void ring_put(Ring *r, void *item);
+
+void *ring_take(Ring *r);
@@ -0,0 +1,127 @@
+// Per-process salts. A 64-bit seed from the kernel's random source (or one
+// chosen to reproduce a run) keys SPECK, which then encrypts a counter:
+// the first blocks are the salts of the hash functions, later ones are
+// fresh salts for rehashing. Without the seed the salts cannot be told
+// from random, so words that flood one tree or pass the Bloom filter
+// cannot be worked out ahead of time.
+#include "salts.h"
+#include "speck.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+// Structure for the salt generator
+// lock = held while drawing
+// seeded = a seed was chosen or drawn
+// seed = the seed, key = SPECK key made from it
+// counter = next block for a fresh salt
+
+static struct {
+    pthread_mutex_t lock;
+    bool seeded;
+    uint64_t seed;
+    uint64_t key[2];
+    uint64_t counter;
+} salts = { PTHREAD_MUTEX_INITIALIZER, false, 0, { 0, 0 }, SALT_COUNT };
+
+// generations numbers tables and filters and every change to them, so an
+// answer remembered from a lookup can be told apart from a stale one
+static uint64_t generations;
+
+// The start() function keys the generator, drawing a seed if none was
+// chosen. The lock is held
+// Inputs: void
+// Outputs: void
+
+static void start(void) {
+    if (!salts.seeded) {
+        if (getrandom(&salts.seed, sizeof(salts.seed), 0) != sizeof(salts.seed)) {
+            // no random source, still differs between processes
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            salts.seed = (uint64_t) now.tv_nsec * 0x9e3779b97f4a7c15ULL ^ (uint64_t) now.tv_sec
+                         ^ (uint64_t) getpid() << 32;
+        }
+        salts.seeded = true;
+    }
+    salts.key[0] = salts.seed;
+    salts.key[1] = 0x62616e68616d6d72ULL; // "banhammr"
+    return;
+}
+
+// The block() function encrypts one counter block
+// Inputs: the counter, where the 128 bits go
+// Outputs: void
+
+static void block(uint64_t counter, uint64_t salt[2]) {
+    uint64_t in[2] = { counter, 0 };
+    speck_expand_key_and_encrypt(in, salt, salts.key);
+    return;
+}
+
+// The salts_seed() function chooses the seed, so a run can be repeated.
+// It has to come before any filter or table is made
+// Inputs: the seed
+// Outputs: void
+
+void salts_seed(uint64_t seed) {
+    pthread_mutex_lock(&salts.lock);
+    salts.seed = seed;
+    salts.seeded = true;
+    salts.counter = SALT_COUNT;
+    pthread_mutex_unlock(&salts.lock);
+    return;
+}
+
+// The salts_get_seed() function gives the seed, drawing it if needed
+// Inputs: void
+// Outputs: the seed
+
+uint64_t salts_get_seed(void) {
+    pthread_mutex_lock(&salts.lock);
+    start();
+    uint64_t seed = salts.seed;
+    pthread_mutex_unlock(&salts.lock);
+    return seed;
+}
+
+// The salts_get() function gives the salt of one hash function, the same
+// every time in one process
+// Inputs: which hash function, where the salt goes
+// Outputs: void
+
+void salts_get(Salt which, uint64_t salt[2]) {
+    pthread_mutex_lock(&salts.lock);
+    start();
+    block(which, salt);
+    pthread_mutex_unlock(&salts.lock);
+    return;
+}
+
+// The salts_fresh() function gives a salt never handed out before
+// Inputs: where the salt goes
+// Outputs: void
+
+void salts_fresh(uint64_t salt[2]) {
+    pthread_mutex_lock(&salts.lock);
+    start();
+    block(salts.counter++, salt);
+    pthread_mutex_unlock(&salts.lock);
+    return;
+}
+
+// The salts_generation() function draws a number that no table or filter,
+// and no state of one, has had. Tables and filters draw a new one when
+// they are made, rehashed or frozen, and when a load publishes its
+// inserts, all from this one counter, so the newest number of a
+// dictionary changes whenever any part of it does. Single inserts do not
+// draw one
+// Inputs: void
+// Outputs: the generation
+
+uint64_t salts_generation(void) {
+    return __atomic_add_fetch(&generations, 1, __ATOMIC_RELAXED);
+}
@@ -1,17 +1,19 @@
 #pragma once
 
-// Grimm's Fairy Tales
-#define SALT_PRIMARY_LO 0x5adf08ae86d36f21 // Lower 64-bits.
-#define SALT_PRIMARY_HI 0xa267bbd3116f3957 // Upper 64-bits.
+#include <stdint.h>
 
-// The Adventures of Sherlock Holmes
-#define SALT_SECONDARY_LO 0x419d292ea2ffd49e // Lower 64-bits.
-#define SALT_SECONDARY_HI 0x09601433057d5786 // Upper 64-bits.
+// The salted hash functions, each gets its own 128-bit salt. They used to
+// be constants (taken from Grimm's Fairy Tales, The Adventures of Sherlock
+// Holmes, The Strange Case of Dr. Jekyll and Mr. Hyde and Leviathan), now
+// every process draws its own so nobody can work out words that collide
+typedef enum { SALT_PRIMARY, SALT_SECONDARY, SALT_TERTIARY, SALT_HASHTABLE, SALT_COUNT } Salt;
 
-// The Strange Case of Dr. Jekyll and Mr. Hyde
-#define SALT_TERTIARY_LO 0x50d8bb08de3818df // Lower 64-bits.
-#define SALT_TERTIARY_HI 0x4deaae187c16ae1d // Upper 64-bits.
+void salts_seed(uint64_t seed);
 
-// Leviathan
-#define SALT_HASHTABLE_LO 0x9846e4f157fe8840 // Lower 64-bits.
-#define SALT_HASHTABLE_HI 0xc5f318d7e055afb8 // Upper 64-bits.
+uint64_t salts_get_seed(void);
+
+void salts_get(Salt which, uint64_t salt[2]);
+
+void salts_fresh(uint64_t salt[2]);
+
+uint64_t salts_generation(void);
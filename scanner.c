@@ -0,0 +1,262 @@
+// Built-in UTF-8 tokenizer used instead of the regex in parser.c. It reads
+// the input in large blocks (or straight from memory) and hands back words
+// already case folded. In ASCII mode it splits words exactly like the
+// [a-zA-Z0-9_'-]+ regex and lower(). Given a trie, it also walks the trie
+// with every byte it adds to a word, so the word is looked up by the time
+// its end is found.
+#include "scanner.h"
+#include "utf8.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SCAN_BLOCK 65536
+#define HIGH_BITS  0x8080808080808080ULL
+
+// Structure for Scanner
+// infile = the file being tokenized, null when scanning memory
+// block = the buffer file input is read into
+// buffer = input bytes, pos is the next byte and avail the end
+// ascii = only ASCII letters make words, like the regex
+// chars = which ASCII bytes make words, utf8_ascii_word unless changed
+// word = folded copy of the current word, length bytes long
+// capacity = size of the word buffer
+// trie = walked along with each word, or null
+// state = where the walk of the current word is
+
+struct Scanner {
+    FILE *infile;
+    uint8_t *block;
+    const uint8_t *buffer;
+    size_t pos;
+    size_t avail;
+    bool eof;
+    bool ascii;
+    const bool *chars;
+    char *word;
+    size_t length;
+    size_t capacity;
+    const Trie *trie;
+    uint32_t state;
+};
+
+// The scanner_create() function constructs a scanner
+// Inputs: the file to read words from, whether only ASCII letters make
+// words
+// Outputs: a pointer to the scanner
+
+Scanner *scanner_create(FILE *infile, bool ascii) {
+    Scanner *s = (Scanner *) calloc(1, sizeof(Scanner));
+    if (s) {
+        s->infile = infile;
+        s->ascii = ascii;
+        s->chars = utf8_ascii_word;
+        s->block = (uint8_t *) malloc(SCAN_BLOCK);
+        s->buffer = s->block;
+        s->capacity = 256;
+        s->word = (char *) malloc(s->capacity);
+        if (!s->block || !s->word) {
+            free(s->block);
+            free(s->word);
+            free(s);
+            s = NULL;
+        }
+    }
+    return s;
+}
+
+// The scanner_create_buffer() function constructs a scanner over memory
+// Inputs: the bytes to tokenize and how many there are, whether only
+// ASCII letters make words
+// Outputs: a pointer to the scanner
+
+Scanner *scanner_create_buffer(const char *buffer, size_t length, bool ascii) {
+    Scanner *s = (Scanner *) calloc(1, sizeof(Scanner));
+    if (s) {
+        s->buffer = (const uint8_t *) buffer;
+        s->avail = length;
+        s->eof = true; // everything is already here
+        s->ascii = ascii;
+        s->chars = utf8_ascii_word;
+        s->capacity = 256;
+        s->word = (char *) malloc(s->capacity);
+        if (!s->word) {
+            free(s);
+            s = NULL;
+        }
+    }
+    return s;
+}
+
+// The scanner_word_chars() function changes which ASCII bytes make words
+// for one scanner, leaving every other scanner alone
+// Inputs: a pointer to the scanner, a table of 128 flags (kept, not copied)
+// Outputs: void
+
+void scanner_word_chars(Scanner *s, const bool *chars) {
+    s->chars = chars;
+    return;
+}
+
+// The scanner_trie() function has the scanner walk a trie with every
+// word, scanner_found() then gives the word's node
+// Inputs: a pointer to the scanner, the trie (kept, not copied)
+// Outputs: void
+
+void scanner_trie(Scanner *s, const Trie *t) {
+    s->trie = t;
+    return;
+}
+
+// The scanner_found() function gives the node of the word the last
+// scanner_next() returned, from the trie walk
+// Inputs: a pointer to the scanner, which has a trie
+// Outputs: the node, or null if the word is not in the trie
+
+Node *scanner_found(Scanner *s) {
+    return trie_found(s->trie, s->state);
+}
+
+// The scanner_delete() function destructs the scanner
+// Inputs: a pointer to a pointer to the scanner
+// Outputs: void
+
+void scanner_delete(Scanner **s) {
+    if (*s) {
+        free((*s)->block);
+        free((*s)->word);
+        free(*s);
+        *s = NULL;
+    }
+    return;
+}
+
+// The scanner_fill() function moves the unread bytes to the front of the
+// buffer and reads more after them. It takes whatever one read() gives,
+// so words that already arrived on a pipe or terminal are handed back
+// without waiting for a whole block
+// Inputs: a pointer to the scanner
+// Outputs: void
+
+static void scanner_fill(Scanner *s) {
+    size_t left = s->avail - s->pos;
+    memmove(s->block, s->block + s->pos, left);
+    s->pos = 0;
+    s->avail = left;
+    ssize_t got;
+    do {
+        got = read(fileno(s->infile), s->block + left, SCAN_BLOCK - left);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) {
+        s->eof = true;
+    }
+    s->avail += got > 0 ? (size_t) got : 0;
+    return;
+}
+
+// The scanner_short() function checks if the unread bytes could be a
+// multibyte character that was cut off, more must be read then
+// Inputs: a pointer to the scanner
+// Outputs: true if there is nothing left or only part of a character
+
+static bool scanner_short(Scanner *s) {
+    size_t left = s->avail - s->pos;
+    if (left == 0) {
+        return true;
+    }
+    uint8_t lead = s->buffer[s->pos];
+    if (left >= 4 || s->ascii || lead < 0xC2 || lead >= 0xF5) {
+        return false;
+    }
+    return left < (lead < 0xE0 ? 2u : lead < 0xF0 ? 3u : 4u);
+}
+
+// The scanner_reserve() function makes room in the word buffer
+// Inputs: a pointer to the scanner, how many more bytes are needed
+// Outputs: void
+
+static void scanner_reserve(Scanner *s, size_t more) {
+    if (s->length + more + 1 > s->capacity) {
+        while (s->length + more + 1 > s->capacity) {
+            s->capacity *= 2;
+        }
+        char *word = (char *) realloc(s->word, s->capacity);
+        if (!word) {
+            perror("realloc");
+            exit(1);
+        }
+        s->word = word;
+    }
+    return;
+}
+
+// The scanner_next() function finds the next word in the input
+// Inputs: a pointer to the scanner
+// Outputs: the next word, lower case, or a null pointer at the end of
+// the input (the word is overwritten by the next call)
+
+char *scanner_next(Scanner *s) {
+    s->length = 0;
+    s->state = TRIE_ROOT;
+    while (true) {
+        // keep a whole multibyte character in the buffer
+        while (!s->eof && scanner_short(s)) {
+            scanner_fill(s);
+        }
+        if (s->pos >= s->avail) {
+            break; // end of input
+        }
+        // ASCII fast path, eight bytes at a time
+        if (s->avail - s->pos >= 8) {
+            uint64_t chunk;
+            memcpy(&chunk, s->buffer + s->pos, 8);
+            if (!(chunk & HIGH_BITS)) {
+                chunk = utf8_lower8(chunk);
+                uint8_t bytes[8];
+                memcpy(bytes, &chunk, 8);
+                scanner_reserve(s, 8);
+                for (uint32_t i = 0; i < 8; i += 1) {
+                    if (s->chars[bytes[i]]) {
+                        s->word[s->length++] = (char) bytes[i];
+                        if (s->trie) {
+                            s->state = trie_step(s->trie, s->state, bytes[i]);
+                        }
+                    } else if (s->length) {
+                        // word ended inside this chunk
+                        s->pos += i + 1;
+                        s->word[s->length] = '\0';
+                        return s->word;
+                    }
+                }
+                s->pos += 8;
+                continue;
+            }
+        }
+        // one character at a time, possibly multibyte
+        uint32_t cp = s->buffer[s->pos];
+        if (s->ascii) {
+            // anything outside ASCII splits words, one byte at a time
+            s->pos += 1;
+        } else {
+            s->pos += utf8_decode(s->buffer + s->pos, s->avail - s->pos, &cp);
+        }
+        if (cp < 0x80 ? s->chars[cp] : !s->ascii && utf8_is_word(cp)) {
+            scanner_reserve(s, 4);
+            size_t start = s->length;
+            s->length += utf8_encode(utf8_fold(cp), (uint8_t *) s->word + s->length);
+            for (size_t i = start; s->trie && i < s->length; i += 1) {
+                s->state = trie_step(s->trie, s->state, (uint8_t) s->word[i]);
+            }
+        } else if (s->length) {
+            break;
+        }
+    }
+    if (!s->length) {
+        return NULL;
+    }
+    s->word[s->length] = '\0';
+    return s->word;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "node.h"
+#include "trie.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+typedef struct Scanner Scanner;
+
+Scanner *scanner_create(FILE *infile, bool ascii);
+
+Scanner *scanner_create_buffer(const char *buffer, size_t length, bool ascii);
+
+void scanner_word_chars(Scanner *s, const bool *chars);
+
+void scanner_trie(Scanner *s, const Trie *t);
+
+Node *scanner_found(Scanner *s);
+
+void scanner_delete(Scanner **s);
+
+char *scanner_next(Scanner *s);
@@ -0,0 +1,345 @@
+// A loaded dictionary shared by every banhammer process on a host through
+// POSIX shared memory. The first process to use a name loads the word
+// lists as usual and publishes them as one segment: the Bloom filters,
+// prefilter and hash table written as images that hold offsets rather than
+// pointers, so the segment reads the same wherever it is mapped. Later
+// processes map it read-only instead of loading anything, and the whole
+// host probes one copy that stays warm in the shared caches.
+//
+// A small control segment (/banhammer.name) holds the current version.
+// Each version is its own segment (/banhammer.name.version), written in
+// full before the control segment points at it, so a reload publishes a
+// new version while processes still scanning with the old one keep their
+// mapping until they exit.
+#include "segment.h"
+#include "salts.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Marks a banhammer segment, "bhsegmnt" read as a little-endian word
+#define SEGMENT_MAGIC 0x746e6d6765736862ULL
+
+// Every image starts on its own cache line
+#define SEGMENT_ALIGN 64
+
+// Times to try attaching while another process publishes a new version
+#define SEGMENT_TRIES 4
+
+// Longest shared memory name used
+#define SEGMENT_NAME 256
+
+// Structure for the control segment
+// magic = SEGMENT_MAGIC once the control segment is set up
+// version = the current version, 0 before the first is published
+
+typedef struct {
+    uint64_t magic;
+    uint64_t version;
+} Control;
+
+// Structure for the head of a dictionary segment, the images follow it
+// magic, format = SEGMENT_MAGIC and SEGMENT_FORMAT
+// version = which version of the dictionary this is
+// seed = salt seed of the process that built it, the salts themselves are
+// in the images
+// bytes = size of the whole segment
+// options = SegmentOption bits it was built with
+// phrase_lengths, categories = as in the dictionary
+// bf, phrases, pf, ht, names = where each image starts, from the start of
+// the segment, 0 if there is none
+
+typedef struct {
+    uint64_t magic;
+    uint64_t format;
+    uint64_t version;
+    uint64_t seed;
+    uint64_t bytes;
+    uint64_t options;
+    uint64_t phrase_lengths;
+    uint64_t categories;
+    uint64_t bf;
+    uint64_t phrases;
+    uint64_t pf;
+    uint64_t ht;
+    uint64_t names;
+} Header;
+
+// Structure for an attached segment
+// header = the mapped segment
+// names = the category names, pointing into the segment
+
+struct Segment {
+    const Header *header;
+    const char **names;
+};
+
+// The shm_name() function makes the shared memory name of a segment
+// Inputs: where the name goes, the segment name, the version (0 for the
+// control segment)
+// Outputs: false if the name is empty, too long or has a slash in it
+
+static bool shm_name(char *out, const char *name, uint64_t version) {
+    if (!*name || strchr(name, '/')) {
+        return false;
+    }
+    int length = version ? snprintf(out, SEGMENT_NAME, "/banhammer.%s.%" PRIu64, name, version)
+                         : snprintf(out, SEGMENT_NAME, "/banhammer.%s", name);
+    return length > 0 && length < SEGMENT_NAME;
+}
+
+// The align() function rounds an offset up to the next image boundary
+// Inputs: the offset
+// Outputs: the rounded offset
+
+static uint64_t align(uint64_t offset) {
+    return (offset + SEGMENT_ALIGN - 1) & ~(uint64_t) (SEGMENT_ALIGN - 1);
+}
+
+// The control() function maps the control segment of a name
+// Inputs: the segment name, whether to create it and map it writable
+// Outputs: the control segment, or null if there is none or it failed
+
+static Control *control(const char *name, bool create) {
+    char path[SEGMENT_NAME];
+    if (!shm_name(path, name, 0)) {
+        return NULL;
+    }
+    int fd = shm_open(path, create ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if ((!create || !ftruncate(fd, sizeof(Control))) && !fstat(fd, &st)
+        && (size_t) st.st_size >= sizeof(Control)) {
+        map = mmap(NULL, sizeof(Control), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+            fd, 0);
+    }
+    close(fd);
+    return map == MAP_FAILED ? NULL : (Control *) map;
+}
+
+// The segment_publish() function writes a loaded dictionary into a new
+// version of a segment and makes it the current one, the version before
+// it is unlinked (processes using it keep it until they let go)
+// Inputs: the segment name, the dictionary (its table is exported as it
+// is), the SegmentOption bits it was loaded with
+// Outputs: false if the segment could not be written
+
+bool segment_publish(const char *name, Dictionary *dict, Set options) {
+    Control *c = control(name, true);
+    if (!c) {
+        return false;
+    }
+    uint64_t previous = __atomic_load_n(&c->version, __ATOMIC_ACQUIRE);
+    Header head = { SEGMENT_MAGIC, SEGMENT_FORMAT, previous + 1, salts_get_seed(), 0, options,
+        dict->phrase_lengths, dict->categories, 0, 0, 0, 0, 0 };
+    // lay the images out one after another
+    uint64_t offset = align(sizeof(Header));
+    head.bf = offset;
+    offset = align(offset + bf_export(dict->bf, NULL));
+    if (dict->phrases) {
+        head.phrases = offset;
+        offset = align(offset + bf_export(dict->phrases, NULL));
+    }
+    if (dict->pf) {
+        head.pf = offset;
+        offset = align(offset + pf_export(dict->pf, NULL));
+    }
+    uint64_t table = ht_export(dict->ht, NULL);
+    head.ht = offset;
+    offset = align(offset + table);
+    head.names = offset;
+    offset += dict->categories * sizeof(uint64_t);
+    for (uint32_t i = 0; i < dict->categories; i += 1) {
+        offset += strlen(dict->category_names[i]) + 1;
+    }
+    head.bytes = offset;
+
+    char path[SEGMENT_NAME];
+    bool named = table && shm_name(path, name, head.version);
+    int fd = named ? shm_open(path, O_RDWR | O_CREAT | O_EXCL, 0644) : -1;
+    if (fd < 0) {
+        munmap(c, sizeof(Control));
+        // another process is publishing this very version
+        return named && errno == EEXIST;
+    }
+    char *image = ftruncate(fd, (off_t) head.bytes)
+                      ? (char *) MAP_FAILED
+                      : (char *) mmap(NULL, head.bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    bool ok = image != MAP_FAILED;
+    if (ok) {
+        memcpy(image, &head, sizeof(Header));
+        bf_export(dict->bf, image + head.bf);
+        if (dict->phrases) {
+            bf_export(dict->phrases, image + head.phrases);
+        }
+        if (dict->pf) {
+            pf_export(dict->pf, image + head.pf);
+        }
+        ok = ht_export(dict->ht, image + head.ht) == table;
+        uint64_t *names = (uint64_t *) (image + head.names);
+        uint64_t next = head.names + dict->categories * sizeof(uint64_t);
+        for (uint32_t i = 0; i < dict->categories; i += 1) {
+            names[i] = next;
+            next += strlen(strcpy(image + next, dict->category_names[i])) + 1;
+        }
+        munmap(image, head.bytes);
+    }
+    if (!ok) {
+        shm_unlink(path);
+        munmap(c, sizeof(Control));
+        return false;
+    }
+    // written in full, now point new processes at it
+    __atomic_store_n(&c->magic, SEGMENT_MAGIC, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->version, head.version, __ATOMIC_RELEASE);
+    munmap(c, sizeof(Control));
+    if (previous && shm_name(path, name, previous)) {
+        shm_unlink(path);
+    }
+    return true;
+}
+
+// The map() function maps one version of a segment read-only and checks
+// that it is whole and of this format
+// Inputs: the segment name, the version
+// Outputs: the mapped header, or null if it is gone or not usable
+
+static const Header *map(const char *name, uint64_t version) {
+    char path[SEGMENT_NAME];
+    int fd = shm_name(path, name, version) ? shm_open(path, O_RDONLY, 0) : -1;
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *m = MAP_FAILED;
+    if (!fstat(fd, &st) && (size_t) st.st_size >= sizeof(Header)) {
+        m = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (m == MAP_FAILED) {
+        return NULL;
+    }
+    const Header *h = (const Header *) m;
+    if (h->magic != SEGMENT_MAGIC || h->format != SEGMENT_FORMAT || h->version != version
+        || h->bytes != (uint64_t) st.st_size || h->categories > CATEGORY_MAX) {
+        munmap(m, (size_t) st.st_size);
+        return NULL;
+    }
+    return h;
+}
+
+// The segment_attach() function maps the current version of a segment
+// Inputs: the segment name
+// Outputs: the segment, or null if none has been published
+
+Segment *segment_attach(const char *name) {
+    Control *c = control(name, false);
+    if (!c) {
+        return NULL;
+    }
+    const Header *h = NULL;
+    for (uint32_t i = 0; !h && i < SEGMENT_TRIES; i += 1) {
+        uint64_t version = __atomic_load_n(&c->version, __ATOMIC_ACQUIRE);
+        if (!version || __atomic_load_n(&c->magic, __ATOMIC_RELAXED) != SEGMENT_MAGIC) {
+            break;
+        }
+        // may be gone already if a newer version was just published
+        h = map(name, version);
+    }
+    munmap(c, sizeof(Control));
+    Segment *s = h ? (Segment *) calloc(1, sizeof(Segment)) : NULL;
+    const char **names
+        = s ? (const char **) calloc(h->categories ? h->categories : 1, sizeof(char *)) : NULL;
+    if (!names) {
+        free(s);
+        if (h) {
+            munmap((void *) h, h->bytes);
+        }
+        return NULL;
+    }
+    const uint64_t *offsets = (const uint64_t *) ((const char *) h + h->names);
+    for (uint64_t i = 0; i < h->categories; i += 1) {
+        names[i] = (const char *) h + offsets[i];
+    }
+    s->header = h;
+    s->names = names;
+    return s;
+}
+
+// The segment_dictionary() function fills in a dictionary from a
+// segment, the filters and table read the segment where it is mapped
+// Inputs: the segment, the dictionary (its bf, ht, pf and phrases are
+// freed as usual, before the segment is detached)
+// Outputs: false if memory ran out
+
+bool segment_dictionary(Segment *s, Dictionary *dict) {
+    const Header *h = s->header;
+    const char *base = (const char *) h;
+    dict->bf = bf_attach(base + h->bf);
+    dict->phrases = h->phrases ? bf_attach(base + h->phrases) : NULL;
+    dict->pf = h->pf ? pf_attach(base + h->pf) : NULL;
+    dict->ht = ht_attach(base + h->ht);
+    dict->phrase_lengths = (uint32_t) h->phrase_lengths;
+    dict->category_names = s->names;
+    dict->categories = (uint32_t) h->categories;
+    return dict->bf && dict->ht && (!h->phrases || dict->phrases) && (!h->pf || dict->pf);
+}
+
+// The segment_detach() function lets go of a segment
+// Inputs: a pointer to the pointer to the segment
+// Outputs: void
+
+void segment_detach(Segment **s) {
+    if (*s) {
+        munmap((void *) (*s)->header, (*s)->header->bytes);
+        free((*s)->names);
+        free(*s);
+        *s = NULL;
+    }
+    return;
+}
+
+// The segment_version() function gives the version attached
+// Inputs: the segment
+// Outputs: the version
+
+uint64_t segment_version(Segment *s) {
+    return s->header->version;
+}
+
+// The segment_seed() function gives the salt seed the segment was built
+// with, which -r repeats
+// Inputs: the segment
+// Outputs: the seed
+
+uint64_t segment_seed(Segment *s) {
+    return s->header->seed;
+}
+
+// The segment_bytes() function gives the size of the segment
+// Inputs: the segment
+// Outputs: the size in bytes
+
+uint64_t segment_bytes(Segment *s) {
+    return s->header->bytes;
+}
+
+// The segment_options() function gives the options the segment was built
+// with
+// Inputs: the segment
+// Outputs: the SegmentOption bits
+
+Set segment_options(Segment *s) {
+    return (Set) s->header->options;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "verdict.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Format of the segment layout, bumped whenever an image changes shape so
+// an older build never reads a newer segment
+#define SEGMENT_FORMAT 1
+
+// Options a dictionary is folded and filtered with, every process sharing
+// a segment has to agree on them
+typedef enum { SEGMENT_UNICODE, SEGMENT_PREFILTER } SegmentOption;
+
+typedef struct Segment Segment;
+
+bool segment_publish(const char *name, Dictionary *dict, Set options);
+
+Segment *segment_attach(const char *name);
+
+bool segment_dictionary(Segment *s, Dictionary *dict);
+
+void segment_detach(Segment **s);
+
+uint64_t segment_version(Segment *s);
+
+uint64_t segment_seed(Segment *s);
+
+uint64_t segment_bytes(Segment *s);
+
+Set segment_options(Segment *s);
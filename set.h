@@ -38,15 +38,15 @@ static inline Set empty_set(void) {
 }
 
 static inline bool member_set(uint32_t x, Set s) {
-    return (s & (0x1 << (x & mask)));
+    return (s & ((Set) 1 << (x & mask)));
 }
 
 static inline Set insert_set(uint32_t x, Set s) {
-    return (s | (0x1 << (x & mask)));
+    return (s | ((Set) 1 << (x & mask)));
 }
 
 static inline Set delete_set(uint32_t x, Set s) {
-    return (s & ~(0x1 << (x & mask)));
+    return (s & ~((Set) 1 << (x & mask)));
 }
 
 static inline Set union_set(Set s, Set t) {
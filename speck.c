@@ -71,3 +71,7 @@ uint32_t hash(uint64_t *salt, char *key) {
 
     return value.half[0] ^ value.half[1];
 }
+
+uint64_t hash64(uint64_t *salt, char *key) {
+    return keyed_hash(key, strlen(key), salt);
+}
@@ -2,4 +2,14 @@
 
 #include <stdint.h>
 
+void speck_expand_key_and_encrypt(uint64_t pt[], uint64_t ct[], uint64_t K[]);
+
 uint32_t hash(uint64_t *salt, char *key);
+
+uint64_t hash64(uint64_t *salt, char *key);
+
+// Index below size from a keyed hash: the 32-bit hash covers tables up to
+// 2^32 entries, bigger ones need all 64 bits
+static inline uint64_t hash_index(uint64_t *salt, char *key, uint64_t size) {
+    return size <= ((uint64_t) 1 << 32) ? hash(salt, key) % size : hash64(salt, key) % size;
+}
@@ -0,0 +1,215 @@
+// Suffix stripping for inflected English words, so the dictionary only has
+// to list a stem (hate) to also catch hates, hated, hating and hater. The
+// suffixes are a table tried longest first, then the stem is tidied the
+// way Porter's step 1b does (hopp -> hop, hop -> hope). Words the rules
+// would get wrong, and irregular forms, are in an exception list looked
+// up first.
+#include "stem.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Structure for one suffix rule
+// suffix = what the word ends with
+// ending = what replaces it
+// keep = letters that, just before the suffix, mean the word is not
+// inflected (bus, this, pass)
+// tidy = undouble or restore an e on the stem afterwards
+
+typedef struct {
+    const char *suffix;
+    const char *ending;
+    const char *keep;
+    bool tidy;
+} Rule;
+
+// Longest suffixes first, the first one that matches decides
+static const Rule rules[] = {
+    { "sses", "ss", "", false },
+    { "ches", "ch", "", false },
+    { "shes", "sh", "", false },
+    { "ies", "y", "", false },
+    { "ied", "y", "", false },
+    { "eed", "ee", "", false },
+    { "xes", "x", "", false },
+    { "ing", "", "", true },
+    { "ed", "", "", true },
+    { "er", "", "", true },
+    { "s", "", "siu", false },
+};
+
+// Structure for one exception
+// word = the inflected form
+// stem = its stem, or null if the word is not inflected at all
+
+typedef struct {
+    const char *word;
+    const char *stem;
+} Exception;
+
+// Sorted by word, for bsearch()
+static const Exception exceptions[] = {
+    { "after", NULL },
+    { "always", NULL },
+    { "anything", NULL },
+    { "ate", "eat" },
+    { "better", NULL },
+    { "ceiling", NULL },
+    { "children", "child" },
+    { "did", "do" },
+    { "does", "do" },
+    { "done", "do" },
+    { "during", NULL },
+    { "evening", NULL },
+    { "ever", NULL },
+    { "everything", NULL },
+    { "feet", "foot" },
+    { "goes", "go" },
+    { "gone", "go" },
+    { "made", "make" },
+    { "men", "man" },
+    { "morning", NULL },
+    { "never", NULL },
+    { "news", NULL },
+    { "nothing", NULL },
+    { "number", NULL },
+    { "order", NULL },
+    { "other", NULL },
+    { "over", NULL },
+    { "paid", "pay" },
+    { "paper", NULL },
+    { "ran", "run" },
+    { "said", "say" },
+    { "saw", "see" },
+    { "seen", "see" },
+    { "series", NULL },
+    { "something", NULL },
+    { "species", NULL },
+    { "stole", "steal" },
+    { "stolen", "steal" },
+    { "taken", "take" },
+    { "took", "take" },
+    { "under", NULL },
+    { "used", "use" },
+    { "water", NULL },
+    { "went", "go" },
+    { "women", "woman" },
+    { "written", "write" },
+    { "wrote", "write" },
+};
+
+// The consonant() function checks if a letter of a word is a consonant,
+// y is one unless it follows a consonant
+// Inputs: the word, the letter's index
+// Outputs: true if it is a consonant
+
+static bool consonant(const char *word, size_t i) {
+    switch (word[i]) {
+    case 'a':
+    case 'e':
+    case 'i':
+    case 'o':
+    case 'u': return false;
+    case 'y': return i == 0 || !consonant(word, i - 1);
+    default: return true;
+    }
+}
+
+// The measure() function counts the vowel-consonant runs of a stem
+// (Porter's m), hop has one and hopeless three
+// Inputs: the stem, its length
+// Outputs: the count
+
+static uint32_t measure(const char *word, size_t length) {
+    uint32_t m = 0;
+    bool vowel = false;
+    for (size_t i = 0; i < length; i += 1) {
+        if (!consonant(word, i)) {
+            vowel = true;
+        } else if (vowel) {
+            m += 1;
+            vowel = false;
+        }
+    }
+    return m;
+}
+
+// The tidy() function fixes a stem left by -ed, -ing or -er: hopp becomes
+// hop, hop becomes hope, creat becomes create
+// Inputs: the stem, its length (room for one more letter)
+// Outputs: the new length
+
+static size_t tidy(char *word, size_t length) {
+    char last = word[length - 1];
+    if (length >= 2 && last == word[length - 2] && consonant(word, length - 1)) {
+        // doubled for the suffix, but ll, ss and zz are the stem's own
+        return last == 'l' || last == 's' || last == 'z' ? length : length - 1;
+    }
+    bool restore = (length >= 2 && !strncmp(word + length - 2, "at", 2))
+                   || (length >= 2 && !strncmp(word + length - 2, "bl", 2))
+                   || (length >= 2 && !strncmp(word + length - 2, "iz", 2));
+    // a short stem ending consonant, vowel, consonant lost its e
+    restore = restore
+              || (length >= 3 && measure(word, length) == 1 && consonant(word, length - 1)
+                  && !consonant(word, length - 2) && consonant(word, length - 3) && last != 'w'
+                  && last != 'x' && last != 'y');
+    if (restore) {
+        word[length] = 'e';
+        return length + 1;
+    }
+    return length;
+}
+
+// The compare() function orders exceptions by word, for bsearch()
+// Inputs: the word looked for, an exception
+// Outputs: less than, equal to or greater than 0
+
+static int compare(const void *word, const void *exception) {
+    return strcmp((const char *) word, ((const Exception *) exception)->word);
+}
+
+// The stem() function finds the stem of a lowercase word
+// Inputs: the word, where the stem goes (STEM_LONGEST + 1 bytes)
+// Outputs: the length of the stem, or 0 if the word is not inflected
+
+size_t stem(const char *word, char *out) {
+    size_t length = strlen(word);
+    if (length > STEM_LONGEST) {
+        return 0;
+    }
+    const Exception *e = (const Exception *) bsearch(
+        word, exceptions, sizeof(exceptions) / sizeof(exceptions[0]), sizeof(Exception), compare);
+    if (e) {
+        if (!e->stem) {
+            return 0;
+        }
+        strcpy(out, e->stem);
+        return strlen(out);
+    }
+    for (size_t r = 0; r < sizeof(rules) / sizeof(rules[0]); r += 1) {
+        const Rule *rule = &rules[r];
+        size_t suffix = strlen(rule->suffix);
+        if (length <= suffix || strcmp(word + length - suffix, rule->suffix)) {
+            continue;
+        }
+        size_t base = length - suffix;
+        if (base < 2 || strchr(rule->keep, word[base - 1])) {
+            return 0;
+        }
+        memcpy(out, word, base);
+        if (rule->tidy) {
+            base = tidy(out, base);
+        }
+        size_t ending = strlen(rule->ending);
+        memcpy(out + base, rule->ending, ending + 1);
+        for (size_t i = 0; i < base + ending; i += 1) {
+            if (!consonant(out, i)) {
+                return base + ending;
+            }
+        }
+        return 0; // a stem needs a vowel, bring is not br + ing
+    }
+    return 0;
+}
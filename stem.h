@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+
+// Longest word that is stemmed, longer words are only matched as written
+#define STEM_LONGEST 64
+
+size_t stem(const char *word, char *out);
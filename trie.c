@@ -0,0 +1,241 @@
+// Double-array trie over the single words of a loaded hash table, used
+// as a lookup engine the scanner walks while it is still reading a word.
+// Every state is an index: its children for byte c live at base + c, and
+// check says which state owns that slot. One add and one compare per
+// byte, no hashing, and the word is known once its last byte is read.
+// Phrases stay with the hash table, a scanned word never has a space.
+#include "trie.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// check of a slot no state owns
+#define TRIE_FREE UINT32_MAX
+
+// The trie_delete() function frees the trie
+// Inputs: a pointer to the pointer to the trie
+// Outputs: void
+
+void trie_delete(Trie **t) {
+    if (*t) {
+        free((*t)->base);
+        free((*t)->check);
+        free((*t)->value);
+        free((*t)->nodes);
+        free(*t);
+        *t = NULL;
+    }
+    return;
+}
+
+// The grow() function makes room for states up to an index, plus the 256
+// slots any state's children may need. The new slots join the free list
+// Inputs: the trie, the highest index wanted
+// Outputs: false if memory ran out
+
+static bool grow(Trie *t, uint32_t index) {
+    if (index + 257 <= t->size) {
+        return true;
+    }
+    uint32_t size = t->size ? t->size : 256;
+    while (index + 257 > size) {
+        size *= 2;
+    }
+    uint32_t *base = (uint32_t *) realloc(t->base, size * sizeof(uint32_t));
+    t->base = base ? base : t->base;
+    uint32_t *check = (uint32_t *) realloc(t->check, size * sizeof(uint32_t));
+    t->check = check ? check : t->check;
+    uint32_t *value = (uint32_t *) realloc(t->value, size * sizeof(uint32_t));
+    t->value = value ? value : t->value;
+    if (!base || !check || !value) {
+        return false;
+    }
+    // slot 0 ends the list, trie_create() takes it out of the list first
+    for (uint32_t i = t->size; i < size; i += 1) {
+        t->check[i] = TRIE_FREE;
+        t->base[i] = i + 1 < size ? i + 1 : 0;
+        t->value[i] = i ? i - 1 : 0;
+    }
+    if (t->last) {
+        t->base[t->last] = t->size;
+    } else {
+        t->free = t->size;
+    }
+    t->value[t->size] = t->last;
+    t->last = size - 1;
+    t->size = size;
+    return true;
+}
+
+// The take() function removes a slot from the free list
+// Inputs: the trie, the slot
+// Outputs: void
+
+static void take(Trie *t, uint32_t slot) {
+    uint32_t next = t->base[slot], previous = t->value[slot];
+    if (previous) {
+        t->base[previous] = next;
+    } else {
+        t->free = next;
+    }
+    if (next) {
+        t->value[next] = previous;
+    } else {
+        t->last = previous;
+    }
+    t->base[slot] = 0;
+    t->value[slot] = 0;
+    return;
+}
+
+// The collect() function gathers every single word of a tree
+// Inputs: the trie, the root
+// Outputs: void
+
+static void collect(Trie *t, Node *root) {
+    if (root) {
+        if (!strchr(root->oldspeak, ' ')) {
+            t->nodes[t->count++] = root;
+        }
+        collect(t, root->left);
+        collect(t, root->right);
+    }
+    return;
+}
+
+// The compare() function orders two nodes by their words, for qsort()
+// Inputs: pointers to the two node pointers
+// Outputs: a value like strcmp() gives
+
+static int compare(const void *a, const void *b) {
+    return strcmp((*(Node *const *) a)->oldspeak, (*(Node *const *) b)->oldspeak);
+}
+
+// The place() function adds the words of a sorted range below a state.
+// They all share their first depth bytes, which lead to the state
+// Inputs: the trie, the range of nodes, the depth, the state
+// Outputs: false if memory ran out
+
+static bool place(Trie *t, uint32_t lo, uint32_t hi, uint32_t depth, uint32_t state) {
+    if (lo < hi && t->nodes[lo]->length == depth) {
+        // the shortest word ends here, sorting put it first
+        t->value[state] = lo + 1;
+        lo += 1;
+    }
+    if (lo == hi) {
+        return true;
+    }
+    // the distinct next bytes, in order
+    uint8_t bytes[256];
+    uint32_t count = 0;
+    for (uint32_t i = lo; i < hi; i += 1) {
+        uint8_t c = (uint8_t) t->nodes[i]->oldspeak[depth];
+        if (!count || bytes[count - 1] != c) {
+            bytes[count++] = c;
+        }
+    }
+    // the first base where every child's slot is free, trying only the
+    // bases that put the first child in a free slot
+    uint32_t base = 0;
+    for (uint32_t slot = t->free; true; slot = t->base[slot]) {
+        if (!slot) {
+            // no free slot fits, the new ones will
+            slot = t->size;
+            if (!grow(t, slot)) {
+                return false;
+            }
+        }
+        if (slot <= bytes[0]) {
+            continue;
+        }
+        base = slot - bytes[0];
+        if (!grow(t, base + 255)) {
+            return false;
+        }
+        uint32_t i = 1;
+        while (i < count && t->check[base + bytes[i]] == TRIE_FREE) {
+            i += 1;
+        }
+        if (i == count) {
+            break;
+        }
+    }
+    t->base[state] = base;
+    for (uint32_t i = 0; i < count; i += 1) {
+        take(t, base + bytes[i]);
+        t->check[base + bytes[i]] = state;
+    }
+    // then each child, over the words that go through it
+    uint32_t first = lo;
+    for (uint32_t i = 0; i < count; i += 1) {
+        uint32_t last = first;
+        while (last < hi && (uint8_t) t->nodes[last]->oldspeak[depth] == bytes[i]) {
+            last += 1;
+        }
+        if (!place(t, first, last, depth + 1, base + bytes[i])) {
+            return false;
+        }
+        first = last;
+    }
+    return true;
+}
+
+// The trie_create() function compiles the single words of a hash table
+// into a trie. The nodes are the table's own, so the table has to stay
+// as it is (frozen or not) while the trie is used
+// Inputs: a pointer to the hash table
+// Outputs: a pointer to the trie, or null if memory ran out
+
+Trie *trie_create(HashTable *ht) {
+    Trie *t = (Trie *) calloc(1, sizeof(Trie));
+    if (!t) {
+        return NULL;
+    }
+    uint64_t words = 0;
+    for (uint64_t i = 0; i < ht_size(ht); i += 1) {
+        words += bst_size(ht_tree(ht, i));
+    }
+    t->nodes = (Node **) malloc((words ? words : 1) * sizeof(Node *));
+    if (!t->nodes || !grow(t, TRIE_ROOT)) {
+        trie_delete(&t);
+        return NULL;
+    }
+    for (uint64_t i = 0; i < ht_size(ht); i += 1) {
+        collect(t, ht_tree(ht, i));
+    }
+    qsort(t->nodes, t->count, sizeof(Node *), compare);
+    // the dead state and the root are never handed out, the root owns
+    // itself so no child is placed on it
+    take(t, TRIE_DEAD);
+    take(t, TRIE_ROOT);
+    t->check[TRIE_ROOT] = TRIE_ROOT;
+    if (!place(t, 0, t->count, 0, TRIE_ROOT)) {
+        trie_delete(&t);
+        return NULL;
+    }
+    // the free slots keep list links, clear them
+    for (uint32_t slot = t->free, next; slot; slot = next) {
+        next = t->base[slot];
+        t->base[slot] = 0;
+        t->value[slot] = 0;
+    }
+    return t;
+}
+
+// The trie_slots() function counts the slots of the trie
+// Inputs: the trie
+// Outputs: the number of slots, used or not
+
+uint32_t trie_slots(Trie *t) {
+    return t->size;
+}
+
+// The trie_bytes() function finds how much memory the trie uses, not
+// counting the nodes, which belong to the hash table
+// Inputs: the trie
+// Outputs: the number of bytes
+
+uint64_t trie_bytes(Trie *t) {
+    return sizeof(Trie) + 3 * (uint64_t) t->size * sizeof(uint32_t)
+           + (uint64_t) t->count * sizeof(Node *);
+}
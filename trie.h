@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ht.h"
+#include "node.h"
+
+#include <stdint.h>
+
+// State a walk starts in, and the state it ends in once no word can match
+#define TRIE_ROOT 1
+#define TRIE_DEAD 0
+
+typedef struct Trie Trie;
+
+// Structure for a compiled trie, only walked through trie_step()
+// base = where each state's children start, by byte
+// check = the parent of each state, TRIE_FREE for none
+// value = index of each state's word in nodes plus one, 0 for none
+// size = number of slots in each of the three arrays
+// nodes, count = the words, sorted, and how many there are
+// free, last = first and last free slot while building, the free slots
+// are a list linked through their base (next) and value (previous)
+
+struct Trie {
+    uint32_t *base;
+    uint32_t *check;
+    uint32_t *value;
+    uint32_t size;
+    Node **nodes;
+    uint32_t count;
+    uint32_t free;
+    uint32_t last;
+};
+
+Trie *trie_create(HashTable *ht);
+
+void trie_delete(Trie **t);
+
+// The trie_step() function follows one byte from a state, a dead walk
+// stays dead without a test, since no state has the dead state as parent
+// Inputs: the trie, the state, the byte
+// Outputs: the next state
+
+static inline uint32_t trie_step(const Trie *t, uint32_t state, uint8_t byte) {
+    uint32_t next = t->base[state] + byte;
+    return t->check[next] == state ? next : TRIE_DEAD;
+}
+
+// The trie_found() function gives the word a walk ended on
+// Inputs: the trie, the state after the last byte
+// Outputs: the node of the word, or null if the bytes are not a word
+
+static inline Node *trie_found(const Trie *t, uint32_t state) {
+    return t->value[state] ? t->nodes[t->value[state] - 1] : NULL;
+}
+
+uint32_t trie_slots(Trie *t);
+
+uint64_t trie_bytes(Trie *t);
@@ -0,0 +1,154 @@
+// Minimal io_uring interface for queueing reads, talking to the kernel
+// through syscall() so no extra library is needed. Only what the pipeline
+// reader uses is here: queue a read, wait for one to finish.
+#include "uring.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Structure for Uring
+// fd = the ring's file descriptor
+// sq, cq = the submission and completion ring mappings, and their sizes
+// sqes = the submission queue entries and their mapping size
+// sq_head, sq_tail, sq_mask, sq_array = fields inside the submission ring
+// cq_head, cq_tail, cq_mask, cqes = fields inside the completion ring
+
+struct Uring {
+    int fd;
+    void *sq;
+    size_t sq_size;
+    void *cq;
+    size_t cq_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    _Atomic uint32_t *sq_head;
+    _Atomic uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t *sq_array;
+    _Atomic uint32_t *cq_head;
+    _Atomic uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+// The uring_create() function sets up an io_uring
+// Inputs: how many reads may be queued at once
+// Outputs: a pointer to the ring, or null if the kernel does not allow it
+
+Uring *uring_create(uint32_t entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int) syscall(SYS_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return NULL;
+    }
+    Uring *u = (Uring *) calloc(1, sizeof(Uring));
+    if (!u) {
+        close(fd);
+        return NULL;
+    }
+    u->fd = fd;
+    u->sq_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    u->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        // both rings live in one mapping
+        u->sq_size = u->cq_size = u->sq_size > u->cq_size ? u->sq_size : u->cq_size;
+    }
+    u->sq = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+        IORING_OFF_SQ_RING);
+    u->cq = params.features & IORING_FEAT_SINGLE_MMAP
+                ? u->sq
+                : mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_CQ_RING);
+    u->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = (struct io_uring_sqe *) mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (u->sq == MAP_FAILED || u->cq == MAP_FAILED || u->sqes == MAP_FAILED) {
+        uring_delete(&u);
+        return NULL;
+    }
+    char *sq = (char *) u->sq;
+    char *cq = (char *) u->cq;
+    u->sq_head = (_Atomic uint32_t *) (sq + params.sq_off.head);
+    u->sq_tail = (_Atomic uint32_t *) (sq + params.sq_off.tail);
+    u->sq_mask = *(uint32_t *) (sq + params.sq_off.ring_mask);
+    u->sq_array = (uint32_t *) (sq + params.sq_off.array);
+    u->cq_head = (_Atomic uint32_t *) (cq + params.cq_off.head);
+    u->cq_tail = (_Atomic uint32_t *) (cq + params.cq_off.tail);
+    u->cq_mask = *(uint32_t *) (cq + params.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return u;
+}
+
+// The uring_delete() function tears down the io_uring
+// Inputs: a pointer to a pointer to the ring
+// Outputs: void
+
+void uring_delete(Uring **u) {
+    if (*u) {
+        if ((*u)->sqes && (*u)->sqes != MAP_FAILED) {
+            munmap((*u)->sqes, (*u)->sqes_size);
+        }
+        if ((*u)->cq && (*u)->cq != MAP_FAILED && (*u)->cq != (*u)->sq) {
+            munmap((*u)->cq, (*u)->cq_size);
+        }
+        if ((*u)->sq && (*u)->sq != MAP_FAILED) {
+            munmap((*u)->sq, (*u)->sq_size);
+        }
+        close((*u)->fd);
+        free(*u);
+        *u = NULL;
+    }
+    return;
+}
+
+// The uring_read() function queues a read and hands it to the kernel
+// Inputs: the ring, the file, where to read to and how much, the file
+// offset (-1 for the current position), a tag to know it by when it is
+// done
+// Outputs: false if it could not be queued
+
+bool uring_read(Uring *u, int fd, void *buffer, uint32_t length, int64_t offset, uint64_t tag) {
+    uint32_t tail = atomic_load_explicit(u->sq_tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(u->sq_head, memory_order_acquire) > u->sq_mask) {
+        return false; // submission queue full
+    }
+    uint32_t index = tail & u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t) (uintptr_t) buffer;
+    sqe->len = length;
+    sqe->off = (uint64_t) offset;
+    sqe->user_data = tag;
+    u->sq_array[index] = index;
+    atomic_store_explicit(u->sq_tail, tail + 1, memory_order_release);
+    return syscall(SYS_io_uring_enter, u->fd, 1, 0, 0, NULL, 0) == 1;
+}
+
+// The uring_wait() function waits for a queued read to finish
+// Inputs: the ring, where to store its tag and its result (bytes read, or
+// a negative errno)
+// Outputs: false if waiting failed
+
+bool uring_wait(Uring *u, uint64_t *tag, int32_t *result) {
+    uint32_t head = atomic_load_explicit(u->cq_head, memory_order_relaxed);
+    while (head == atomic_load_explicit(u->cq_tail, memory_order_acquire)) {
+        if (syscall(SYS_io_uring_enter, u->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0
+            && errno != EINTR) {
+            return false;
+        }
+    }
+    struct io_uring_cqe *cqe = &u->cqes[head & u->cq_mask];
+    *tag = cqe->user_data;
+    *result = cqe->res;
+    atomic_store_explicit(u->cq_head, head + 1, memory_order_release);
+    return true;
+}
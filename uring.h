@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct Uring Uring;
+
+Uring *uring_create(uint32_t entries);
+
+void uring_delete(Uring **u);
+
+bool uring_read(Uring *u, int fd, void *buffer, uint32_t length, int64_t offset, uint64_t tag);
+
+bool uring_wait(Uring *u, uint64_t *tag, int32_t *result);
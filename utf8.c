@@ -0,0 +1,307 @@
+// Small UTF-8 decoder and simple Unicode case folder. Only the scripts we
+// see in traffic are covered (Latin-1, Latin Extended-A/B, Greek and
+// Cyrillic), everything else outside ASCII is treated as punctuation.
+// Every letter in them with a lower case of the same UTF-8 length is
+// folded, so upper and lower case spellings of a word compare equal.
+#include "utf8.h"
+
+#include <string.h>
+
+#define HIGH_BITS 0x8080808080808080ULL
+
+bool utf8_ascii_word[128] = {
+    ['\''] = true,
+    ['-'] = true,
+    ['_'] = true,
+    ['0'] = true, ['1'] = true, ['2'] = true, ['3'] = true, ['4'] = true,
+    ['5'] = true, ['6'] = true, ['7'] = true, ['8'] = true, ['9'] = true,
+    ['A'] = true, ['B'] = true, ['C'] = true, ['D'] = true, ['E'] = true,
+    ['F'] = true, ['G'] = true, ['H'] = true, ['I'] = true, ['J'] = true,
+    ['K'] = true, ['L'] = true, ['M'] = true, ['N'] = true, ['O'] = true,
+    ['P'] = true, ['Q'] = true, ['R'] = true, ['S'] = true, ['T'] = true,
+    ['U'] = true, ['V'] = true, ['W'] = true, ['X'] = true, ['Y'] = true,
+    ['Z'] = true,
+    ['a'] = true, ['b'] = true, ['c'] = true, ['d'] = true, ['e'] = true,
+    ['f'] = true, ['g'] = true, ['h'] = true, ['i'] = true, ['j'] = true,
+    ['k'] = true, ['l'] = true, ['m'] = true, ['n'] = true, ['o'] = true,
+    ['p'] = true, ['q'] = true, ['r'] = true, ['s'] = true, ['t'] = true,
+    ['u'] = true, ['v'] = true, ['w'] = true, ['x'] = true, ['y'] = true,
+    ['z'] = true,
+};
+
+// The utf8_word_chars() function lets more ASCII characters appear in
+// words, such as the look-alikes fuzzy matching folds
+// Inputs: the characters, as a string
+// Outputs: void
+
+void utf8_word_chars(const char *chars) {
+    for (; *chars; chars += 1) {
+        if ((uint8_t) *chars < 128) {
+            utf8_ascii_word[(uint8_t) *chars] = true;
+        }
+    }
+    return;
+}
+
+// The utf8_plain() function checks if a byte is a word character without
+// any utf8_word_chars() added: [a-zA-Z0-9_'-] or part of a multi-byte
+// character
+// Inputs: the byte
+// Outputs: true if it is
+
+bool utf8_plain(uint8_t c) {
+    return c >= 0x80 || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+           || c == '_' || c == '\'' || c == '-';
+}
+
+// Structure for a folding range
+// first, last = the code points the range covers
+// step = 1 if every code point folds, 2 if only every other one does
+// delta = what to add to an upper case code point to get its lower case
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    uint32_t step;
+    int32_t delta;
+} FoldRange;
+
+static const FoldRange folds[] = {
+    { 0x00C0, 0x00D6, 1, 0x20 }, // Latin-1 À-Ö
+    { 0x00D8, 0x00DE, 1, 0x20 }, // Latin-1 Ø-Þ
+    { 0x0100, 0x012F, 2, 1 }, // Latin Extended-A pairs
+    { 0x0130, 0x0130, 1, -0x00C7 }, // İ folds to i
+    { 0x0132, 0x0137, 2, 1 },
+    { 0x0139, 0x0148, 2, 1 },
+    { 0x014A, 0x0177, 2, 1 },
+    { 0x0178, 0x0178, 1, -0x0079 }, // Ÿ folds to ÿ
+    { 0x0179, 0x017E, 2, 1 },
+    { 0x0181, 0x0181, 1, 0xD2 }, // Latin Extended-B, mostly to IPA letters
+    { 0x0182, 0x0184, 2, 1 },
+    { 0x0186, 0x0186, 1, 0xCE },
+    { 0x0187, 0x0187, 1, 1 },
+    { 0x0189, 0x018A, 1, 0xCD },
+    { 0x018B, 0x018B, 1, 1 },
+    { 0x018E, 0x018E, 1, 0x4F },
+    { 0x018F, 0x018F, 1, 0xCA },
+    { 0x0190, 0x0190, 1, 0xCB },
+    { 0x0191, 0x0191, 1, 1 },
+    { 0x0193, 0x0193, 1, 0xCD },
+    { 0x0194, 0x0194, 1, 0xCF },
+    { 0x0196, 0x0196, 1, 0xD3 },
+    { 0x0197, 0x0197, 1, 0xD1 },
+    { 0x0198, 0x0198, 1, 1 },
+    { 0x019C, 0x019C, 1, 0xD3 },
+    { 0x019D, 0x019D, 1, 0xD5 },
+    { 0x019F, 0x019F, 1, 0xD6 },
+    { 0x01A0, 0x01A4, 2, 1 },
+    { 0x01A6, 0x01A6, 1, 0xDA },
+    { 0x01A7, 0x01A7, 1, 1 },
+    { 0x01A9, 0x01A9, 1, 0xDA },
+    { 0x01AC, 0x01AC, 1, 1 },
+    { 0x01AE, 0x01AE, 1, 0xDA },
+    { 0x01AF, 0x01AF, 1, 1 },
+    { 0x01B1, 0x01B2, 1, 0xD9 },
+    { 0x01B3, 0x01B5, 2, 1 },
+    { 0x01B7, 0x01B7, 1, 0xDB },
+    { 0x01B8, 0x01B8, 1, 1 },
+    { 0x01BC, 0x01BC, 1, 1 },
+    { 0x01C4, 0x01C4, 1, 2 }, // Ǆ and ǅ both fold to ǆ, and so on
+    { 0x01C5, 0x01C5, 1, 1 },
+    { 0x01C7, 0x01C7, 1, 2 },
+    { 0x01C8, 0x01C8, 1, 1 },
+    { 0x01CA, 0x01CA, 1, 2 },
+    { 0x01CB, 0x01DB, 2, 1 },
+    { 0x01DE, 0x01EE, 2, 1 },
+    { 0x01F1, 0x01F1, 1, 2 },
+    { 0x01F2, 0x01F4, 2, 1 },
+    { 0x01F6, 0x01F6, 1, -0x0061 },
+    { 0x01F7, 0x01F7, 1, -0x0038 },
+    { 0x01F8, 0x021E, 2, 1 },
+    { 0x0220, 0x0220, 1, -0x0082 },
+    { 0x0222, 0x0232, 2, 1 },
+    { 0x023B, 0x023B, 1, 1 }, // Ⱥ and Ⱦ are left, they fold to 3 byte characters
+    { 0x023D, 0x023D, 1, -0x00A3 },
+    { 0x0241, 0x0241, 1, 1 },
+    { 0x0243, 0x0243, 1, -0x00C3 },
+    { 0x0244, 0x0244, 1, 0x45 },
+    { 0x0245, 0x0245, 1, 0x47 },
+    { 0x0246, 0x024E, 2, 1 },
+    { 0x0370, 0x0372, 2, 1 }, // Greek archaic letters
+    { 0x0376, 0x0376, 1, 1 },
+    { 0x037F, 0x037F, 1, 0x74 },
+    { 0x0386, 0x0386, 1, 0x26 }, // Greek capitals with tonos
+    { 0x0388, 0x038A, 1, 0x25 },
+    { 0x038C, 0x038C, 1, 0x40 },
+    { 0x038E, 0x038F, 1, 0x3F },
+    { 0x0391, 0x03A1, 1, 0x20 }, // Greek Α-Ρ
+    { 0x03A3, 0x03AB, 1, 0x20 }, // Greek Σ-Ϋ
+    { 0x03CF, 0x03CF, 1, 8 },
+    { 0x03D8, 0x03EE, 2, 1 }, // Greek and Coptic pairs
+    { 0x03F4, 0x03F4, 1, -0x003C },
+    { 0x03F7, 0x03F7, 1, 1 },
+    { 0x03F9, 0x03F9, 1, -0x0007 },
+    { 0x03FA, 0x03FA, 1, 1 },
+    { 0x03FD, 0x03FF, 1, -0x0082 },
+    { 0x0400, 0x040F, 1, 0x50 }, // Cyrillic Ѐ-Џ
+    { 0x0410, 0x042F, 1, 0x20 }, // Cyrillic А-Я
+    { 0x0460, 0x0481, 2, 1 },
+    { 0x048A, 0x04BF, 2, 1 },
+    { 0x04C0, 0x04C0, 1, 15 }, // Ӏ folds to ӏ
+    { 0x04C1, 0x04CD, 2, 1 },
+    { 0x04D0, 0x04FE, 2, 1 },
+};
+
+// The utf8_decode() function decodes one character
+// Inputs: the bytes to decode and how many of them there are
+// Outputs: how many bytes were used, the code point is stored in cp
+// (a bad sequence uses 1 byte and decodes to U+FFFD)
+
+uint32_t utf8_decode(const uint8_t *s, size_t n, uint32_t *cp) {
+    uint32_t lead = s[0];
+    uint32_t length = lead < 0x80 ? 1 : lead < 0xC2 ? 0 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF5 ? 4 : 0;
+    if (length == 1) {
+        *cp = lead;
+        return 1;
+    }
+    if (length == 0 || length > n) {
+        *cp = 0xFFFD;
+        return 1;
+    }
+    uint32_t value = lead & (0x7F >> length);
+    for (uint32_t i = 1; i < length; i += 1) {
+        if ((s[i] & 0xC0) != 0x80) {
+            // continuation byte missing
+            *cp = 0xFFFD;
+            return 1;
+        }
+        value = (value << 6) | (s[i] & 0x3F);
+    }
+    // reject overlong forms and surrogates
+    if ((length == 3 && (value < 0x800 || (value >= 0xD800 && value <= 0xDFFF)))
+        || (length == 4 && (value < 0x10000 || value > 0x10FFFF))) {
+        *cp = 0xFFFD;
+        return 1;
+    }
+    *cp = value;
+    return length;
+}
+
+// The utf8_encode() function encodes one character
+// Inputs: the code point and where to write it (room for 4 bytes)
+// Outputs: how many bytes were written
+
+uint32_t utf8_encode(uint32_t cp, uint8_t *out) {
+    if (cp < 0x80) {
+        out[0] = (uint8_t) cp;
+        return 1;
+    } else if (cp < 0x800) {
+        out[0] = (uint8_t) (0xC0 | (cp >> 6));
+        out[1] = (uint8_t) (0x80 | (cp & 0x3F));
+        return 2;
+    } else if (cp < 0x10000) {
+        out[0] = (uint8_t) (0xE0 | (cp >> 12));
+        out[1] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (uint8_t) (0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (uint8_t) (0xF0 | (cp >> 18));
+    out[1] = (uint8_t) (0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (uint8_t) (0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// The utf8_is_word() function checks if a character belongs in a word
+// Inputs: the code point
+// Outputs: true for word characters, false for separators
+
+bool utf8_is_word(uint32_t cp) {
+    if (cp < 0x80) {
+        return utf8_ascii_word[cp];
+    }
+    // Latin letters (minus × and ÷), combining accents, Greek, Cyrillic
+    return (cp >= 0x00C0 && cp <= 0x024F && cp != 0x00D7 && cp != 0x00F7)
+           || (cp >= 0x0300 && cp <= 0x03FF && cp != 0x037E && cp != 0x0387)
+           || (cp >= 0x0400 && cp <= 0x04FF);
+}
+
+// The utf8_fold() function finds the lower case of a character
+// Inputs: the code point
+// Outputs: the folded code point, or the same one if it has no case
+
+uint32_t utf8_fold(uint32_t cp) {
+    if (cp < 0x80) {
+        return (cp >= 'A' && cp <= 'Z') ? cp + 0x20 : cp;
+    }
+    // ranges are sorted, find the last one starting at or before cp
+    size_t low = 0;
+    size_t high = sizeof(folds) / sizeof(folds[0]);
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (folds[middle].first <= cp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    const FoldRange *r = low ? &folds[low - 1] : NULL;
+    if (r && cp <= r->last && (cp - r->first) % r->step == 0) {
+        return (uint32_t) ((int32_t) cp + r->delta);
+    }
+    return cp;
+}
+
+// The utf8_lower8() function lowercases 8 ASCII bytes at once
+// Inputs: 8 bytes packed in an integer, all below 0x80
+// Outputs: the same bytes with A-Z turned into a-z
+
+uint64_t utf8_lower8(uint64_t chunk) {
+    // the high bit of each byte ends up set when the byte is >= 'A'
+    uint64_t above = chunk + 0x3F3F3F3F3F3F3F3FULL;
+    // and set again when the byte is > 'Z'
+    uint64_t beyond = chunk + 0x2525252525252525ULL;
+    uint64_t upper = above & ~beyond & HIGH_BITS;
+    // 0x80 >> 2 is 0x20, the case bit
+    return chunk | (upper >> 2);
+}
+
+// The utf8_fold_word() function case folds a whole word in place
+// Inputs: the word (null terminated)
+// Outputs: the same word, folded (it never gets longer)
+
+char *utf8_fold_word(char *word) {
+    size_t length = strlen(word);
+    uint8_t *in = (uint8_t *) word;
+    uint8_t *out = (uint8_t *) word;
+    size_t i = 0;
+    while (i < length) {
+        // ASCII fast path, eight bytes at a time
+        if (length - i >= 8) {
+            uint64_t chunk;
+            memcpy(&chunk, in + i, 8);
+            if (!(chunk & HIGH_BITS)) {
+                chunk = utf8_lower8(chunk);
+                memcpy(out, &chunk, 8);
+                out += 8;
+                i += 8;
+                continue;
+            }
+        }
+        uint32_t cp;
+        uint32_t used = utf8_decode(in + i, length - i, &cp);
+        if (cp == 0xFFFD) {
+            // keep bytes we could not decode as they were
+            *out++ = in[i];
+            i += 1;
+            continue;
+        }
+        uint8_t folded[4];
+        uint32_t size = utf8_encode(utf8_fold(cp), folded);
+        memcpy(out, folded, size);
+        out += size;
+        i += used;
+    }
+    *out = '\0';
+    return word;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Marks the ASCII bytes that can appear in a word: [a-zA-Z0-9_'-] plus
+// any added by utf8_word_chars()
+extern bool utf8_ascii_word[128];
+
+void utf8_word_chars(const char *chars);
+
+bool utf8_plain(uint8_t c);
+
+uint32_t utf8_decode(const uint8_t *s, size_t n, uint32_t *cp);
+
+uint32_t utf8_encode(uint32_t cp, uint8_t *out);
+
+bool utf8_is_word(uint32_t cp);
+
+uint32_t utf8_fold(uint32_t cp);
+
+uint64_t utf8_lower8(uint64_t chunk);
+
+char *utf8_fold_word(char *word);
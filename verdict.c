@@ -0,0 +1,400 @@
+// Checks words against a loaded dictionary and collects what was found, so
+// the same logic serves stdin and every file of a batch. report.c prints it.
+#include "verdict.h"
+#include "bst.h"
+#include "mem.h"
+#include "scanner.h"
+#include "stem.h"
+#include "utf8.h"
+
+#include <stdio.h>
+
+// What a word was found to be the last time it was looked up
+typedef enum { CACHE_EMPTY, CACHE_REJECTED, CACHE_CLEAN, CACHE_FALSE_POSITIVE, CACHE_FOUND,
+    CACHE_FUZZY, CACHE_STEM } Outcome;
+
+// Structure for one hot word cache entry
+// prefix, length = the word, packed like node prefixes
+// generation = the newest generation of the table and filters the answer
+// came from, publishing inserts into one of them draws a newer one
+// node = the node found, null when the word is clean
+// outcome = how the word was decided
+
+typedef struct {
+    uint64_t prefix;
+    uint64_t generation;
+    Node *node;
+    uint32_t length;
+    uint32_t outcome;
+} Cached;
+
+// Most words of a text are a few common ones, so each thread remembers
+// the outcome of the last short words it looked up, direct mapped
+static _Thread_local Cached cache[VERDICT_CACHE];
+
+// The dictionary_local() function picks the bloom filter copy on the
+// NUMA node the calling thread runs on
+// Inputs: a pointer to the dictionary
+// Outputs: the dictionary to use on this thread
+
+Dictionary dictionary_local(Dictionary *dict) {
+    Dictionary local = *dict;
+    if (dict->replicas) {
+        local.bf = dict->replicas[mem_node() % dict->nodes];
+    }
+    return local;
+}
+
+// The verdict_record() function records a word or phrase that was found
+// in the hash table
+// Inputs: a pointer to the verdict, the dictionary, the word, its node (may
+// be null)
+// Outputs: void
+
+static void verdict_record(Verdict *v, Dictionary *dict, char *word, Node *n) {
+    if (!n) {
+        return;
+    }
+    if (dict->freq) {
+        freq_add(dict->freq, n);
+    }
+    // one lookup gave every category the word is listed in
+    v->categories = union_set(v->categories, n->categories);
+    Node **list = &v->categorized_list;
+    if (!n->newspeak && member_set(CATEGORY_BADSPEAK, n->categories)) {
+        // there is no newspeak, thoughtcrime
+        v->punishment = insert_set(THOUGHTCRIME, v->punishment);
+        list = &v->badwords_list;
+    } else if (n->newspeak) {
+        // contains word and newspeak, needs counseling on Rightspeak
+        v->punishment = insert_set(RIGHTSPEAK, v->punishment);
+        list = &v->badwords_list_with_newspeak;
+    }
+    if (v->quick) {
+        return; // the class is all that is wanted, skip copying the word
+    }
+    Node *found = bst_insert_at(list, word, n->newspeak);
+    if (found) {
+        // the report lists the words of each category
+        found->categories = union_set(found->categories, n->categories);
+    }
+    return;
+}
+
+// The verdict_phrases() function checks every phrase that ends at the
+// newest word of the window
+// Inputs: a pointer to the verdict, the dictionary
+// Outputs: void
+
+static void verdict_phrases(Verdict *v, Dictionary *dict) {
+    char phrase[4096];
+    for (uint32_t n = 2; n <= v->window.count; n += 1) {
+        if (!(dict->phrase_lengths & (1u << n))) {
+            continue; // no phrase is this long
+        }
+        if (bf_probe_hash(dict->phrases, window_hash(&v->window, n))
+            && window_join(&v->window, n, phrase, sizeof(phrase))) {
+            verdict_record(v, dict, phrase, ht_lookup(dict->ht, phrase));
+        }
+    }
+    return;
+}
+
+// The verdict_stem() function looks a word up by its stem, one more probe
+// for an inflected word that was not found as written
+// Inputs: a pointer to the verdict, the dictionary, the word
+// Outputs: the node of the stem, or null if there is none
+
+static Node *verdict_stem(Verdict *v, Dictionary *dict, char *word) {
+    char root[STEM_LONGEST + 1];
+    size_t length = dict->stems ? stem(word, root) : 0;
+    if (!length) {
+        return NULL;
+    }
+    Node *n = NULL;
+    if (dict->trie) {
+        // walk the stem in the trie the scanner uses
+        uint32_t state = TRIE_ROOT;
+        for (size_t i = 0; i < length && state != TRIE_DEAD; i += 1) {
+            state = trie_step(dict->trie, state, (uint8_t) root[i]);
+        }
+        n = trie_found(dict->trie, state);
+    } else if ((!dict->pf || pf_probe(dict->pf, root)) && bf_probe(dict->bf, root)) {
+        n = ht_lookup(dict->ht, root);
+    }
+    v->stemmed += n != NULL;
+    return n;
+}
+
+// The verdict_lookup() function finds a word through the hot word cache,
+// the filters and the hash table, then by its stem, then the fuzzy index
+// Inputs: a pointer to the verdict, the dictionary, the word, whether the
+// fuzzy index may be tried
+// Outputs: the node found, or null if the word is clean
+
+static Node *verdict_lookup(Verdict *v, Dictionary *dict, char *word, bool near) {
+    uint32_t length = 0;
+    while (length <= VERDICT_CACHED && word[length]) {
+        length += 1;
+    }
+    Cached *c = NULL;
+    uint64_t prefix = 0;
+    // all are drawn from one counter, so the newest one changes whenever
+    // any of them publishes inserts
+    uint64_t generation = ht_generation(dict->ht);
+    uint64_t filter = bf_generation(dict->bf);
+    uint64_t prefilter = dict->pf ? pf_generation(dict->pf) : 0;
+    generation = filter > generation ? filter : generation;
+    generation = prefilter > generation ? prefilter : generation;
+    if (length <= VERDICT_CACHED) {
+        prefix = node_prefix(word, length);
+        c = &cache[((prefix ^ length) * 0x9e3779b97f4a7c15ULL) >> 32 & (VERDICT_CACHE - 1)];
+        if (c->prefix == prefix && c->length == length && c->generation == generation) {
+            // seen lately, and nothing was inserted since
+            v->cached += 1;
+            if (!near && c->outcome == CACHE_FUZZY) {
+                return NULL; // only a look-alike, not the word as written
+            }
+            v->rejected += c->outcome == CACHE_REJECTED;
+            v->fuzzed += c->outcome == CACHE_FUZZY;
+            v->stemmed += c->outcome == CACHE_STEM;
+            return c->node;
+        }
+    }
+    Node *n = NULL;
+    Outcome outcome = CACHE_CLEAN;
+    if (dict->pf && !pf_probe(dict->pf, word)) {
+        // word cannot be in the dictionary, skip the hashing
+        v->rejected += 1;
+        outcome = CACHE_REJECTED;
+    } else if (bf_probe(dict->bf, word)) {
+        // word is probably in bloom filter
+        n = ht_lookup(dict->ht, word);
+        outcome = n ? CACHE_FOUND : CACHE_FALSE_POSITIVE;
+    }
+    if (!n && (n = verdict_stem(v, dict, word))) {
+        outcome = CACHE_STEM;
+    }
+    if (!n && near && dict->fuzzy) {
+        // not there as written, try look-alikes and typos
+        n = fuzzy_lookup(dict->fuzzy, word, &v->probes);
+        v->fuzzed += n != NULL;
+        outcome = n ? CACHE_FUZZY : outcome;
+    }
+    if (c && (n || near)) {
+        // a miss without the fuzzy index tried says nothing about it
+        c->prefix = prefix;
+        c->length = length;
+        c->generation = generation;
+        c->node = n;
+        c->outcome = outcome;
+    }
+    return n;
+}
+
+// The verdict_word() function checks one word and records it if it is
+// badspeak or oldspeak, along with any phrase it ends
+// Inputs: a pointer to the verdict, the dictionary, the word, whether the
+// fuzzy index may be tried
+// Outputs: true if the word was found
+
+static bool verdict_word(Verdict *v, Dictionary *dict, char *word, bool near) {
+    v->scanned += 1;
+    if (dict->phrases && window_push(&v->window, word)) {
+        verdict_phrases(v, dict);
+    }
+    Node *n = verdict_lookup(v, dict, word, near);
+    verdict_record(v, dict, word, n);
+    return n != NULL;
+}
+
+// The disguised() function checks if look-alike characters that only -e
+// lets into words are part of a word, such as the ! of sh!t
+// Inputs: the word
+// Outputs: true if there are any
+
+static bool disguised(const char *word) {
+    for (; *word; word += 1) {
+        if (!utf8_plain((uint8_t) *word)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The verdict_disguised() function checks a word holding look-alike
+// characters. The words around them are checked first as written, just
+// as they are without -e (he! holds he, be@home holds be and home), and
+// only if none of them is found is the whole word folded and matched
+// through the fuzzy index (sh!t)
+// Inputs: a pointer to the verdict, the dictionary, the word
+// Outputs: void
+
+static void verdict_disguised(Verdict *v, Dictionary *dict, char *word) {
+    bool found = false;
+    char *start = word;
+    for (char *c = word;; c += 1) {
+        if (*c && utf8_plain((uint8_t) *c)) {
+            continue;
+        }
+        if (c > start) {
+            // cut the word out in place for the lookup, then put it back
+            char end = *c;
+            *c = '\0';
+            found = verdict_word(v, dict, start, false) || found;
+            *c = end;
+        }
+        if (!*c) {
+            break;
+        }
+        start = c + 1;
+    }
+    if (!found) {
+        Node *n = fuzzy_lookup(dict->fuzzy, word, &v->probes);
+        v->fuzzed += n != NULL;
+        verdict_record(v, dict, word, n);
+    }
+    return;
+}
+
+// The verdict_check() function checks one lowercase word and records it
+// if it is badspeak or oldspeak, along with any phrase it ends
+// Inputs: a pointer to the verdict, the dictionary, the word
+// Outputs: void
+
+void verdict_check(Verdict *v, Dictionary *dict, char *word) {
+    if (dict->fuzzy && disguised(word)) {
+        verdict_disguised(v, dict, word);
+        return;
+    }
+    verdict_word(v, dict, word, true);
+    return;
+}
+
+// The verdict_scan() function checks every word a scanner finds. With a
+// trie in the dictionary the scanner looks each word up as it reads it,
+// and only words the trie misses go on to their stem and the fuzzy index.
+// A verdict-only scan stops once the punishment is final
+// Inputs: a pointer to the verdict, the dictionary, the scanner
+// Outputs: void
+
+void verdict_scan(Verdict *v, Dictionary *dict, Scanner *s) {
+    if (dict->trie) {
+        scanner_trie(s, dict->trie);
+    }
+    char *word;
+    while (!(v->quick && verdict_decided(v)) && (word = scanner_next(s)) != NULL) {
+        if (!dict->trie || (dict->fuzzy && disguised(word))) {
+            // the trie only holds words as written
+            verdict_check(v, dict, word);
+            continue;
+        }
+        v->scanned += 1;
+        if (dict->phrases && window_push(&v->window, word)) {
+            verdict_phrases(v, dict);
+        }
+        Node *n = scanner_found(s);
+        if (!n) {
+            n = verdict_stem(v, dict, word);
+        }
+        if (!n && dict->fuzzy) {
+            // not there as written, try look-alikes and typos
+            n = fuzzy_lookup(dict->fuzzy, word, &v->probes);
+            v->fuzzed += n != NULL;
+        }
+        verdict_record(v, dict, word, n);
+    }
+    return;
+}
+
+// The verdict_prime() function fills the phrase window with the words a
+// scanner finds, without checking them or the phrases they make, so that
+// a phrase that starts before a piece of input and ends inside it is
+// still matched. Words holding look-alike characters go in as the words
+// around those characters, as verdict_check() puts them in
+// Inputs: a pointer to the verdict, the dictionary, the scanner
+// Outputs: how many words went into the window
+
+uint64_t verdict_prime(Verdict *v, Dictionary *dict, Scanner *s) {
+    uint64_t words = 0;
+    char *word;
+    while (dict->phrases && (word = scanner_next(s)) != NULL) {
+        if (!(dict->fuzzy && disguised(word))) {
+            words += window_push(&v->window, word);
+            continue;
+        }
+        char *start = word;
+        for (char *c = word;; c += 1) {
+            if (*c && utf8_plain((uint8_t) *c)) {
+                continue;
+            }
+            char end = *c;
+            *c = '\0';
+            words += c > start && window_push(&v->window, start);
+            *c = end;
+            if (!end) {
+                break;
+            }
+            start = c + 1;
+        }
+    }
+    return words;
+}
+
+// The verdict_decided() function checks if more words can still change
+// the punishment, once both crimes are found nothing can
+// Inputs: a pointer to the verdict
+// Outputs: true if the punishment is final
+
+bool verdict_decided(Verdict *v) {
+    return member_set(THOUGHTCRIME, v->punishment) && member_set(RIGHTSPEAK, v->punishment);
+}
+
+// The merge_tree() function inserts every node of a tree into another
+// Inputs: the tree to insert into, the tree to copy from
+// Outputs: the tree that was inserted into
+
+static Node *merge_tree(Node *root, Node *other) {
+    if (other) {
+        Node *found = bst_insert_at(&root, other->oldspeak, other->newspeak);
+        if (found) {
+            found->categories = union_set(found->categories, other->categories);
+        }
+        root = merge_tree(root, other->left);
+        root = merge_tree(root, other->right);
+    }
+    return root;
+}
+
+// The verdict_merge() function adds the findings of another verdict, used
+// when one message was scanned in pieces
+// Inputs: a pointer to the verdict, the verdict to merge in
+// Outputs: void
+
+void verdict_merge(Verdict *v, Verdict *other) {
+    v->punishment = union_set(v->punishment, other->punishment);
+    v->categories = union_set(v->categories, other->categories);
+    v->badwords_list = merge_tree(v->badwords_list, other->badwords_list);
+    v->badwords_list_with_newspeak
+        = merge_tree(v->badwords_list_with_newspeak, other->badwords_list_with_newspeak);
+    v->categorized_list = merge_tree(v->categorized_list, other->categorized_list);
+    v->scanned += other->scanned;
+    v->rejected += other->rejected;
+    v->probes += other->probes;
+    v->fuzzed += other->fuzzed;
+    v->cached += other->cached;
+    v->stemmed += other->stemmed;
+    return;
+}
+
+// The verdict_delete() function frees the words held by a verdict
+// Inputs: a pointer to the verdict
+// Outputs: void
+
+void verdict_delete(Verdict *v) {
+    bst_delete(&v->badwords_list);
+    bst_delete(&v->badwords_list_with_newspeak);
+    bst_delete(&v->categorized_list);
+    window_delete(&v->window);
+    return;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "bf.h"
+#include "freq.h"
+#include "fuzzy.h"
+#include "ht.h"
+#include "node.h"
+#include "pf.h"
+#include "phrase.h"
+#include "scanner.h"
+#include "set.h"
+#include "trie.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Entries in each thread's hot word cache (a power of 2), and the longest
+// word it keeps, the cache key holds the word whole
+#define VERDICT_CACHE   512
+#define VERDICT_CACHED  8
+
+// Bits used in the chosen options and punishment sets
+typedef enum { VERBOSE, THOUGHTCRIME, RIGHTSPEAK, PREFILTER, UNICODE, FUZZY, PIPELINE, FREEZE,
+    VERDICT, TRIE, STEM, RELOAD } Banhammer;
+
+// Dictionary categories, one bit each in a node's categories. Badspeak and
+// newspeak always come first, any named category files follow
+#define CATEGORY_MAX 64
+typedef enum { CATEGORY_BADSPEAK, CATEGORY_NEWSPEAK, CATEGORY_FIRST } Category;
+
+// Structure for a loaded dictionary, shared read-only by every scan
+// pf may be null when the prefilter is not used
+// replicas = a copy of bf per NUMA node, or null
+// nodes = how many replicas there are
+// phrases = bloom filter of phrase hashes, or null if there are none
+// phrase_lengths = bit n is set if some phrase has n words
+// fuzzy = index for look-alike and one-typo matches, or null
+// freq = counts of which words are hit, or null when not kept
+// category_names, categories = the name of each category and how many
+// trie = the single words compiled for the scanner to walk, or null
+// stems = words not found as written are looked up by their stem
+
+typedef struct {
+    BloomFilter *bf;
+    HashTable *ht;
+    Prefilter *pf;
+    BloomFilter **replicas;
+    uint32_t nodes;
+    BloomFilter *phrases;
+    uint32_t phrase_lengths;
+    Fuzzy *fuzzy;
+    Freq *freq;
+    const char **category_names;
+    uint32_t categories;
+    Trie *trie;
+    bool stems;
+} Dictionary;
+
+// Structure for the result of scanning one message
+// punishment = THOUGHTCRIME and/or RIGHTSPEAK
+// categories = every category a word found was listed in
+// badwords_list = words with no newspeak
+// badwords_list_with_newspeak = words with a newspeak
+// categorized_list = words only listed in named categories
+// scanned, rejected = words seen, and turned away by the prefilter
+// probes, fuzzed = fuzzy index probes made, and words matched by them
+// cached = words answered by the hot word cache
+// stemmed = words found only by their stem
+// window = the last few words, for matching phrases
+// quick = only the punishment is wanted, no word lists are kept
+
+typedef struct {
+    Set punishment;
+    Set categories;
+    Node *badwords_list;
+    Node *badwords_list_with_newspeak;
+    Node *categorized_list;
+    uint64_t scanned;
+    uint64_t rejected;
+    uint64_t probes;
+    uint64_t fuzzed;
+    uint64_t cached;
+    uint64_t stemmed;
+    Window window;
+    bool quick;
+} Verdict;
+
+Dictionary dictionary_local(Dictionary *dict);
+
+void verdict_check(Verdict *v, Dictionary *dict, char *word);
+
+void verdict_scan(Verdict *v, Dictionary *dict, Scanner *s);
+
+uint64_t verdict_prime(Verdict *v, Dictionary *dict, Scanner *s);
+
+bool verdict_decided(Verdict *v);
+
+void verdict_merge(Verdict *v, Verdict *other);
+
+void verdict_delete(Verdict *v);